@@ -0,0 +1,965 @@
+#pragma once
+
+#include <ecs/Entity.hpp>
+#include <ecs/ComponentContainer.hpp>
+#include <ecs/Registry.hpp>
+#include <ecs/TagContainer.hpp>
+#include <app/EntityFactory.hpp>
+#include <components/PhysicsComponents.hpp>
+#include <systems/CollisionKernels.hpp>
+#include <systems/CollisionSystem.hpp>
+#include <systems/MotionKernels.hpp>
+#include <systems/SpatialSortSystem.hpp>
+#include <utils/Common.hpp>
+#include <utils/JobSystem.hpp>
+#include <utils/SpatialHash.hpp>
+#include <utils/StaticBVH.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Micro benchmarks for the engine internals. None of these need a window, call them from main() instead of the game loop.
+namespace Benchmarks {
+    // Runs func `repeats` times and returns the best wall time in microseconds
+    template <typename Func>
+    inline double _best_time_us(int repeats, Func func) {
+        double best = 1e30;
+        for (int i = 0; i < repeats; i++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            func();
+            auto end = std::chrono::high_resolution_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::micro>(end - start).count());
+        }
+        return best;
+    }
+
+    inline void _print_result(const std::string& name, size_t n, double us) {
+        std::cout << std::left << std::setw(44) << name
+            << std::right << std::setw(8) << n << " entities "
+            << std::setw(10) << std::fixed << std::setprecision(1) << us << " us" << std::endl;
+    }
+
+    // Same as _print_result, plus the number of entities processed per microsecond
+    inline void _print_throughput(const std::string& name, size_t n, double us) {
+        std::cout << std::left << std::setw(44) << name
+            << std::right << std::setw(8) << n << " entities "
+            << std::setw(10) << std::fixed << std::setprecision(1) << us << " us "
+            << std::setw(8) << std::setprecision(1) << n / us << " per us" << std::endl;
+    }
+
+    // The previous unordered_map backed container, kept here only as a baseline
+    template <typename Component>
+    struct _HashMapContainer {
+        std::unordered_map<unsigned int, unsigned int> map_entity_componentID;
+        std::vector<Component> components;
+        std::vector<Entity> entities;
+
+        Component& emplace(Entity e) {
+            map_entity_componentID[e] = (unsigned int)components.size();
+            components.push_back(Component());
+            entities.push_back(e);
+            return components.back();
+        }
+        bool has(Entity e) { return map_entity_componentID.count(e) > 0; }
+        Component& get(Entity e) { return components[map_entity_componentID[e]]; }
+        void remove(Entity e) {
+            if (map_entity_componentID.count(e) > 0) {
+                unsigned int cID = map_entity_componentID[e];
+                components[cID] = std::move(components.back());
+                entities[cID] = entities.back();
+                map_entity_componentID[entities.back()] = cID;
+                map_entity_componentID.erase(e);
+                components.pop_back();
+                entities.pop_back();
+            }
+        }
+    };
+
+    template <typename Container>
+    inline void _run_container_lookup(const std::string& name, std::vector<Entity>& queries, size_t n) {
+        Container container;
+        for (size_t i = 0; i < n; i++) {
+            // Only every other entity gets the component, so half of the has() calls miss
+            if (i % 2 == 0) container.emplace(queries[i]);
+        }
+
+        volatile float sink = 0.0f;
+        double has_get = _best_time_us(5, [&]() {
+            float sum = 0.0f;
+            for (Entity e : queries) {
+                if (container.has(e)) sum += container.get(e).position.x;
+            }
+            sink = sink + sum;
+        });
+        _print_result(name + " has()+get()", n, has_get);
+
+        double remove_insert = _best_time_us(5, [&]() {
+            for (size_t i = 0; i < n; i += 2) container.remove(queries[i]);
+            for (size_t i = 0; i < n; i += 2) container.emplace(queries[i]);
+        });
+        _print_result(name + " remove()+emplace()", n, remove_insert);
+    }
+
+    // Compares the sparse set ComponentContainer against the old unordered_map lookup
+    inline void component_container_lookup() {
+        std::mt19937 rng(42);
+        for (size_t n : { 1000, 10000, 100000 }) {
+            std::vector<Entity> queries(n);
+            std::shuffle(queries.begin(), queries.end(), rng);
+
+            _run_container_lookup<_HashMapContainer<Motion>>("unordered_map", queries, n);
+            _run_container_lookup<ComponentContainer<Motion>>("sparse set", queries, n);
+
+            // try_get() is the single lookup replacement for has() followed by get()
+            ComponentContainer<Motion> container;
+            for (size_t i = 0; i < n; i += 2) container.emplace(queries[i]);
+            volatile float sink = 0.0f;
+            double try_get = _best_time_us(5, [&]() {
+                float sum = 0.0f;
+                for (Entity e : queries) {
+                    if (Motion* motion = container.try_get(e)) sum += motion->position.x;
+                }
+                sink = sink + sum;
+            });
+            _print_result("sparse set try_get()", n, try_get);
+        }
+    }
+
+    // Compares the old "iterate near_players, then has()/get() everything" loops against registry.view<>()
+    inline void registry_view_iteration() {
+        for (size_t n : { 1000, 10000, 100000 }) {
+            Registry registry;
+            for (size_t i = 0; i < n; i++) {
+                Entity e = Entity();
+                registry.motions.emplace(e);
+                registry.near_players.emplace(e);
+                if (i % 3 == 0) registry.locomotion_stats.emplace(e);
+                if (i % 10 == 0) registry.death_cooldowns.emplace(e, 1.0f);
+            }
+
+            volatile float sink = 0.0f;
+            double manual = _best_time_us(5, [&]() {
+                float sum = 0.0f;
+                for (Entity& e : registry.near_players.entities) {
+                    if (registry.motions.has(e) && registry.locomotion_stats.has(e) && !registry.death_cooldowns.has(e)) {
+                        sum += registry.motions.get(e).position.x + registry.locomotion_stats.get(e).health;
+                    }
+                }
+                sink = sink + sum;
+            });
+            _print_result("has()/get() loop", n, manual);
+
+            double view = _best_time_us(5, [&]() {
+                float sum = 0.0f;
+                registry.view<NearPlayer, Motion, LocomotionStats>().exclude<DeathCooldown>().each([&](Entity, NearPlayer&, Motion& motion, LocomotionStats& loco) {
+                    sum += motion.position.x + loco.health;
+                });
+                sink = sink + sum;
+            });
+            _print_result("view<NearPlayer, Motion, LocomotionStats>", n, view);
+        }
+    }
+
+    template <typename Container>
+    inline void _run_tag_rebuild(const std::string& name, std::vector<Entity>& entities) {
+        Container container;
+        volatile size_t sink = 0;
+        double us = _best_time_us(5, [&]() {
+            container.clear();
+            for (size_t i = 0; i < entities.size(); i++) {
+                // Roughly a third of the world is near the player
+                if (i % 3 == 0) container.emplace(entities[i]);
+            }
+            sink = sink + container.size();
+        });
+        _print_result(name + " clear()+emplace()", entities.size(), us);
+    }
+
+    // The per-frame rebuild of NearPlayer in update_near_player_camera, as a sparse set of empty structs and as a TagContainer
+    inline void tag_container_rebuild() {
+        for (size_t n : { 1000, 10000, 100000 }) {
+            std::vector<Entity> entities(n);
+            _run_tag_rebuild<ComponentContainer<NearPlayer>>("sparse set of NearPlayer", entities);
+            _run_tag_rebuild<TagContainer<NearPlayer>>("TagContainer<NearPlayer>", entities);
+        }
+    }
+
+    // MapManager checkpoint snapshot and respawn restore: the Registry copy against a deep copy of the same components
+    inline void registry_snapshot() {
+        for (size_t n : { 1000, 10000, 100000 }) {
+            Registry world;
+            std::vector<Entity> entities;
+            for (size_t i = 0; i < n; i++) {
+                Entity e = Entity();
+                entities.push_back(e);
+                world.motions.emplace(e);
+                // Half of the world are walls, whose shape lives in the ColliderShapeLibrary
+                world.collision_bounds.emplace(e, i % 2 == 0 ? CollisionBounds::create_wall({ 4.0f, 1.0f }, 0.0f) : CollisionBounds::create_circle(1.0f));
+            }
+
+            volatile size_t sink = 0;
+            double deep = _best_time_us(5, [&]() {
+                std::vector<Motion> motions;
+                std::vector<CollisionBounds> bounds;
+                for (size_t i = 0; i < world.motions.size(); i++) motions.push_back(world.motions.components[i]);
+                for (size_t i = 0; i < world.collision_bounds.size(); i++) bounds.push_back(world.collision_bounds.components[i]);
+                sink = sink + motions.size() + bounds.size();
+            });
+            _print_result("deep copy of Motion + CollisionBounds", n, deep);
+
+            Registry snapshot;
+            double copy = _best_time_us(5, [&]() { snapshot = world; });
+            _print_result("registry snapshot (copy-on-write)", n, copy);
+
+            // The first frame after a restore, where 1% of the entities move
+            Registry restored;
+            double first_frame = _best_time_us(5, [&]() {
+                restored = snapshot;
+                for (size_t i = 0; i < n; i += 100) restored.motions.get(entities[i]).position.x += 1.0f;
+                sink = sink + restored.motions.size();
+            });
+            _print_result("restore + move 1% of motions", n, first_frame);
+        }
+    }
+
+    // PhysicsSystem::step integration: the old per-Motion loop against the MotionSoA kernels, with and without the gather/scatter
+    inline void motion_integration() {
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> random(-10.0f, 10.0f);
+        const float dt = 1.0f / 60.0f;
+
+        for (size_t n : { 1000, 10000, 100000 }) {
+            std::vector<Motion> motions(n);
+            for (Motion& motion : motions) {
+                motion.position = { random(rng), random(rng) };
+                motion.velocity = { random(rng), random(rng) };
+                motion.acceleration = { random(rng), random(rng) };
+                motion.drag = std::abs(random(rng));
+            }
+
+            double aos = _best_time_us(5, [&]() {
+                for (Motion& motion : motions) {
+                    glm::vec2 drag = -Common::normalize(motion.velocity) * motion.drag;
+                    motion.velocity += (motion.acceleration + drag) * dt;
+                    motion.position += motion.velocity * dt;
+                }
+            });
+            _print_throughput("Motion loop (array of structs)", n, aos);
+
+            MotionSoA bodies;
+            for (const Motion& motion : motions) bodies.push_back(motion);
+
+            double scalar = _best_time_us(5, [&]() { MotionKernels::integrate_scalar(bodies, 0, bodies.size(), dt); });
+            _print_throughput("MotionSoA scalar kernel", n, scalar);
+
+            double simd = _best_time_us(5, [&]() { MotionKernels::integrate(bodies, dt); });
+            _print_throughput(MOTION_KERNELS_SSE2 ? "MotionSoA SSE2 kernel" : "MotionSoA kernel (no SIMD)", n, simd);
+
+            double full = _best_time_us(5, [&]() {
+                bodies.clear();
+                for (const Motion& motion : motions) bodies.push_back(motion);
+                MotionKernels::integrate(bodies, dt);
+                for (size_t i = 0; i < motions.size(); i++) bodies.scatter(i, motions[i]);
+            });
+            _print_throughput("gather + kernel + scatter", n, full);
+
+            // PhysicsSystem::step with PHYSICS_SOA_INTEGRATION off and on
+            Registry registry;
+            for (const Motion& motion : motions) {
+                Entity e = Entity();
+                registry.motions.insert(e, motion);
+                registry.near_players.emplace(e);
+            }
+            double step_aos = _best_time_us(5, [&]() {
+                registry.view<NearPlayer, Motion>().each([&](Entity, NearPlayer&, Motion& motion) {
+                    glm::vec2 drag = -Common::normalize(motion.velocity) * motion.drag;
+                    motion.velocity += (motion.acceleration + drag) * dt;
+                    motion.position += motion.velocity * dt;
+                });
+            });
+            _print_throughput("view + Motion loop", n, step_aos);
+
+            std::vector<Motion*> body_motions;
+            double step_soa = _best_time_us(5, [&]() {
+                bodies.clear();
+                body_motions.clear();
+                registry.view<NearPlayer, Motion>().each([&](Entity, NearPlayer&, Motion& motion) {
+                    bodies.push_back(motion);
+                    body_motions.push_back(&motion);
+                });
+                MotionKernels::integrate(bodies, dt);
+                for (size_t i = 0; i < body_motions.size(); i++) bodies.scatter(i, *body_motions[i]);
+            });
+            _print_throughput("view + gather + kernel + scatter", n, step_soa);
+        }
+    }
+
+    // Stress test of the JobSystem: nested parallel loops, dependency chains and exceptions, on pools of several sizes.
+    // Prints one line per pool size and whether every job ran exactly once.
+    inline void job_system_stress() {
+        const unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned int workers : { 0u, 1u, 3u, hardware - 1, hardware * 2 }) {
+            JobSystem jobs(workers);
+            bool ok = true;
+
+            for (int round = 0; round < 200; round++) {
+                // Nested loops, every item counted once
+                const size_t outer = 64, inner = 257;
+                std::vector<std::atomic<int>> hits(outer * inner);
+                for (auto& hit : hits) hit = 0;
+                jobs.parallel_for(0, outer, 1, [&](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; i++) {
+                        jobs.parallel_for(0, inner, 8, [&](size_t inner_begin, size_t inner_end) {
+                            for (size_t j = inner_begin; j < inner_end; j++) hits[i * inner + j]++;
+                        });
+                    }
+                });
+                for (auto& hit : hits) ok = ok && hit == 1;
+
+                // A chain of groups, each starting only after the previous one is done
+                std::atomic<int> stage{ 0 };
+                std::atomic<int> out_of_order{ 0 };
+                JobSystem::Counter first, second, third;
+                for (int i = 0; i < 16; i++) jobs.run([&]() { stage.fetch_add(1); }, &first);
+                for (int i = 0; i < 16; i++) {
+                    jobs.run_after(first, [&]() { if (stage.load() < 16) out_of_order++; stage.fetch_add(1); }, &second);
+                }
+                jobs.run_after(second, [&]() { if (stage.load() < 32) out_of_order++; }, &third);
+                jobs.wait(third);
+                jobs.wait(second);
+                jobs.wait(first);
+                ok = ok && out_of_order == 0 && stage == 32;
+
+                // An exception reaches the waiting thread and the other jobs still finish
+                std::atomic<int> finished{ 0 };
+                bool caught = false;
+                try {
+                    jobs.parallel_for(0, 100, 1, [&](size_t begin, size_t end) {
+                        for (size_t i = begin; i < end; i++) {
+                            if (i == 57) throw std::runtime_error("job failed");
+                            finished++;
+                        }
+                    });
+                } catch (const std::runtime_error&) {
+                    caught = true;
+                }
+                ok = ok && caught && finished <= 99;
+            }
+
+            std::cout << std::left << std::setw(44) << "job system stress"
+                << std::right << std::setw(8) << jobs.thread_count() << " threads  "
+                << (ok ? "ok" : "FAILED") << std::endl;
+        }
+    }
+
+    // CollisionSystem::check_collisions on a world whose components are stored in random order, as the map generator
+    // leaves them, and on the same world after SpatialSortSystem::sort_by_position. Uses the open world registry,
+    // which CollisionSystem reads, so only call it without a running game.
+    inline void spatial_sort_collisions() {
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> random(-200.0f, 200.0f);
+        const size_t n = 10000;
+
+        MapManager::get_instance().load_maps();
+        Registry& world = MapManager::get_instance().get_active_registry();
+        world.clear_all_components();
+        for (size_t i = 0; i < n; i++) {
+            Entity e = Entity();
+            world.motions.emplace(e).position = { random(rng), random(rng) };
+            world.collision_bounds.emplace(e, i % 10 == 0 ? CollisionBounds::create_wall({ 4.0f, 1.0f }, 0.0f) : CollisionBounds::create_circle(1.0f));
+            world.teams.emplace(e).team_id = (TEAM_ID)(i % 2);
+            world.near_players.emplace(e);
+        }
+
+        size_t pairs = 0;
+        auto run = [&]() {
+            CollisionSystem::check_collisions();
+            pairs = CollisionSystem::contacts().size();
+        };
+
+        double shuffled = _best_time_us(10, run);
+        _print_result("check_collisions, shuffled storage", n, shuffled);
+        const size_t shuffled_pairs = pairs;
+
+        double sort = _best_time_us(1, [&]() { SpatialSortSystem::sort_by_position(world); });
+        _print_result("sort_by_position", n, sort);
+        double resort = _best_time_us(5, [&]() { SpatialSortSystem::sort_by_position(world); });
+        _print_result("sort_by_position, already sorted", n, resort);
+
+        double sorted = _best_time_us(10, run);
+        _print_result("check_collisions, Morton sorted storage", n, sorted);
+        std::cout << "  " << shuffled_pairs << " / " << pairs << " collisions" << std::endl;
+        world.clear_all_components();
+    }
+
+    // Map population: trees created one entity at a time, emplacing every component in turn as create_tree used
+    // to, against EntityFactory::spawn_trees, which fills one reserved container after the other
+    inline void prefab_spawn() {
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> random(-250.0f, 250.0f);
+        for (size_t n : { 1000, 10000, 50000 }) {
+            std::vector<glm::vec2> positions(n);
+            for (glm::vec2& position : positions) position = { random(rng), random(rng) };
+            const std::vector<float> angles(n, 0.0f);
+            // Every run hands out the same entity indices again
+            const Entity::Pool pool = Entity::save_pool();
+
+            double single = _best_time_us(5, [&]() {
+                Registry world;
+                for (size_t i = 0; i < n; i++) {
+                    Entity entity = Entity();
+                    Motion& motion = world.motions.emplace(entity);
+                    motion.position = positions[i];
+                    motion.scale = glm::vec2(4.0f, 4.0f);
+                    world.teams.emplace(entity).team_id = TEAM_ID::NEUTRAL;
+                    world.static_objects.emplace(entity).type = STATIC_OBJECT_TYPE::TREE;
+                    world.collision_bounds.emplace(entity, CollisionBounds::create_circle(Common::max_of(motion.scale) / 2));
+                }
+                Entity::restore_pool(pool);
+            });
+            _print_result("trees, one entity at a time", n, single);
+
+            double batch = _best_time_us(5, [&]() {
+                Registry world;
+                EntityFactory::spawn_trees(world, positions, angles);
+                Entity::restore_pool(pool);
+            });
+            _print_result("trees, spawn_trees", n, batch);
+        }
+    }
+
+    // The previous collision broad phase grid, nested hash maps of cells that each own an entity vector, kept here only as a baseline
+    struct _NestedMapGrid {
+        float cell_size;
+        std::unordered_map<int, std::unordered_map<int, std::vector<Entity>>> cells;
+
+        void clear() {
+            for (auto& column : cells) {
+                for (auto& cell : column.second) cell.second.clear();
+            }
+        }
+
+        void insert(Entity entity, const glm::vec2& pos) {
+            cells[int(std::floor(pos.x / cell_size))][int(std::floor(pos.y / cell_size))].push_back(entity);
+        }
+
+        void get_nearby_entities(const glm::vec2& pos, float radius, std::vector<Entity*>& nearby) {
+            nearby.clear();
+            const int center_x = int(std::floor(pos.x / cell_size));
+            const int center_y = int(std::floor(pos.y / cell_size));
+            const int cell_radius = int(std::ceil(radius / cell_size));
+            for (int x = center_x - cell_radius; x <= center_x + cell_radius; x++) {
+                auto column = cells.find(x);
+                if (column == cells.end()) continue;
+                for (int y = center_y - cell_radius; y <= center_y + cell_radius; y++) {
+                    auto cell = column->second.find(y);
+                    if (cell == column->second.end()) continue;
+                    for (Entity& entity : cell->second) nearby.push_back(&entity);
+                }
+            }
+        }
+    };
+
+    // Collision broad phase: rebuild the grid from moving colliders and query around every one of them, as
+    // check_collisions does each frame, with the nested map grid and with the flat SpatialHash
+    inline void spatial_hash_broad_phase() {
+        const float CELL_SIZE = 10.0f, QUERY_RADIUS = 1.0f + CELL_SIZE;
+        for (size_t n : { 1000, 10000 }) {
+            // Same density at both sizes, about 2.5 colliders per cell
+            const float half_size = 0.5f * std::sqrt(n / 2.5f) * CELL_SIZE;
+            std::mt19937 rng(42);
+            std::uniform_real_distribution<float> random(-half_size, half_size);
+            std::uniform_real_distribution<float> step(-0.5f, 0.5f);
+            const Entity::Pool pool = Entity::save_pool();
+            std::vector<Entity> entities(n, Entity::null());
+            std::vector<glm::vec2> positions(n);
+            for (size_t i = 0; i < n; i++) {
+                entities[i] = Entity();
+                positions[i] = { random(rng), random(rng) };
+            }
+            auto move = [&]() {
+                for (glm::vec2& position : positions) position += glm::vec2(step(rng), step(rng));
+            };
+
+            _NestedMapGrid grid{ CELL_SIZE };
+            std::vector<Entity*> nearby;
+            size_t grid_found = 0;
+            double grid_us = _best_time_us(20, [&]() {
+                move();
+                grid.clear();
+                for (size_t i = 0; i < n; i++) grid.insert(entities[i], positions[i]);
+                grid_found = 0;
+                for (size_t i = 0; i < n; i++) {
+                    grid.get_nearby_entities(positions[i], QUERY_RADIUS, nearby);
+                    grid_found += nearby.size();
+                }
+            });
+            _print_result("broad phase, nested map grid", n, grid_us);
+
+            SpatialHash hash(CELL_SIZE);
+            size_t hash_found = 0;
+            auto rebuild_and_query = [&]() {
+                hash.clear();
+                for (size_t i = 0; i < n; i++) hash.insert(entities[i], positions[i]);
+                hash.build();
+                hash_found = 0;
+                for (size_t i = 0; i < n; i++) {
+                    for (Entity entity : hash.query(positions[i], QUERY_RADIUS)) {
+                        (void)entity;
+                        hash_found++;
+                    }
+                }
+            };
+            // On the positions of the last grid frame, the candidates have to match
+            rebuild_and_query();
+            const size_t same_positions_found = hash_found;
+            double hash_us = _best_time_us(20, [&]() {
+                move();
+                rebuild_and_query();
+            });
+            _print_result("broad phase, flat spatial hash", n, hash_us);
+            std::cout << "  " << grid_found << " / " << same_positions_found << " candidates, "
+                << std::fixed << std::setprecision(2) << grid_us / hash_us << "x faster" << std::endl;
+            Entity::restore_pool(pool);
+        }
+    }
+
+    // Collision broad phase of a map with many walls and trees and few moving colliders: everything in the spatial
+    // hash, every collider querying around itself, against only the moving ones in the hash and a static BVH
+    inline void static_collider_broad_phase() {
+        const float CELL_SIZE = 10.0f, RADIUS = 1.0f;
+        const size_t statics = 20000, movers = 1000;
+        const float half_size = 500.0f;
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> random(-half_size, half_size);
+        std::uniform_real_distribution<float> step(-0.5f, 0.5f);
+        const Entity::Pool pool = Entity::save_pool();
+
+        // Walls of 4 to 40 units and trees of radius 2, as boxes with the radius of their half diagonal
+        std::vector<StaticBVH::Item> static_items;
+        std::vector<float> static_radii;
+        std::vector<glm::vec2> static_positions;
+        std::uniform_real_distribution<float> length(4.0f, 40.0f);
+        for (size_t i = 0; i < statics; i++) {
+            const glm::vec2 position(random(rng), random(rng));
+            const glm::vec2 half = (i % 4 == 0) ? glm::vec2(2.0f) : (i % 2 ? glm::vec2(length(rng), 1.0f) : glm::vec2(1.0f, length(rng))) * 0.5f;
+            static_items.push_back({ position - half, position + half, Entity() });
+            static_radii.push_back(glm::length(half));
+            static_positions.push_back(position);
+        }
+        std::vector<Entity> entities(movers, Entity::null());
+        std::vector<glm::vec2> positions(movers);
+        for (size_t i = 0; i < movers; i++) {
+            entities[i] = Entity();
+            positions[i] = { random(rng), random(rng) };
+        }
+        auto move = [&]() {
+            for (glm::vec2& position : positions) position += glm::vec2(step(rng), step(rng));
+        };
+
+        SpatialHash all(CELL_SIZE);
+        size_t all_found = 0;
+        double all_us = _best_time_us(20, [&]() {
+            move();
+            all.clear();
+            for (size_t i = 0; i < statics; i++) all.insert(static_items[i].entity, static_positions[i]);
+            for (size_t i = 0; i < movers; i++) all.insert(entities[i], positions[i]);
+            all.build();
+            all_found = 0;
+            for (size_t i = 0; i < statics; i++) {
+                for (Entity entity : all.query(static_positions[i], static_radii[i] + CELL_SIZE)) {
+                    (void)entity;
+                    all_found++;
+                }
+            }
+            for (size_t i = 0; i < movers; i++) {
+                for (Entity entity : all.query(positions[i], RADIUS + CELL_SIZE)) {
+                    (void)entity;
+                    all_found++;
+                }
+            }
+        });
+        _print_result("broad phase, statics in the spatial hash", statics + movers, all_us);
+
+        StaticBVH bvh;
+        double build_us = _best_time_us(5, [&]() { bvh.build(static_items); });
+        _print_result("StaticBVH::build, once per map", statics, build_us);
+
+        SpatialHash dynamic(CELL_SIZE);
+        size_t split_found = 0;
+        double split_us = _best_time_us(20, [&]() {
+            move();
+            dynamic.clear();
+            for (size_t i = 0; i < movers; i++) dynamic.insert(entities[i], positions[i]);
+            dynamic.build();
+            split_found = 0;
+            for (size_t i = 0; i < movers; i++) {
+                for (Entity entity : dynamic.query(positions[i], RADIUS + CELL_SIZE)) {
+                    (void)entity;
+                    split_found++;
+                }
+                bvh.query(positions[i] - glm::vec2(RADIUS), positions[i] + glm::vec2(RADIUS), [&](Entity) { split_found++; });
+            }
+        });
+        _print_result("broad phase, moving colliders + static BVH", statics + movers, split_us);
+        std::cout << "  " << all_found << " / " << split_found << " candidates, "
+            << std::fixed << std::setprecision(2) << all_us / split_us << "x faster" << std::endl;
+        Entity::restore_pool(pool);
+    }
+
+    // Narrow phase of a boss arena: the 8 projectiles of an AOE attack against every nearby locomotive, one pair at a
+    // time with a sqrt as before against the CirclePairBatch kernels, and circles against the 4 edges of a wall
+    inline void circle_narrow_phase() {
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> random(-8.0f, 8.0f);
+        const size_t locos = 2000, projectiles = 8, n = locos * projectiles;
+
+        std::vector<glm::vec2> loco_positions(locos), projectile_positions(projectiles);
+        for (glm::vec2& position : loco_positions) position = { random(rng), random(rng) };
+        for (glm::vec2& position : projectile_positions) position = { random(rng), random(rng) };
+        const float loco_radius = 1.0f, projectile_radius = 0.5f;
+
+        size_t pair_hits = 0;
+        double pair_us = _best_time_us(20, [&]() {
+            pair_hits = 0;
+            for (const glm::vec2& loco : loco_positions) {
+                for (const glm::vec2& projectile : projectile_positions) {
+                    pair_hits += glm::length(projectile - loco) < loco_radius + projectile_radius;
+                }
+            }
+        });
+        _print_throughput("circle pairs, one at a time with sqrt", n, pair_us);
+
+        CirclePairBatch<> batch;
+        std::vector<uint32_t> masks;
+        auto count_hits = [&]() {
+            size_t hits = 0;
+            for (uint32_t mask : masks) {
+                for (; mask; mask &= mask - 1) hits++;
+            }
+            return hits;
+        };
+        double gather_us = _best_time_us(20, [&]() {
+            batch.clear();
+            for (const glm::vec2& loco : loco_positions) {
+                for (const glm::vec2& projectile : projectile_positions) {
+                    batch.push_back(loco, loco_radius, projectile, projectile_radius);
+                }
+            }
+        });
+        _print_throughput("CirclePairBatch gather", n, gather_us);
+        masks.resize(CollisionKernels::mask_words(batch.size()));
+
+        double scalar_us = _best_time_us(20, [&]() { CollisionKernels::circle_circle_scalar(batch, 0, batch.size(), masks.data()); });
+        const size_t scalar_hits = count_hits();
+        _print_throughput("circle pairs, scalar squared kernel", n, scalar_us);
+
+        double simd_us = _best_time_us(20, [&]() { CollisionKernels::circle_circle(batch, masks.data()); });
+        _print_throughput(COLLISION_KERNELS_SSE2 ? "circle pairs, SSE2 kernel" : "circle pairs, kernel (no SIMD)", n, simd_us);
+        std::cout << "  " << pair_hits << " / " << scalar_hits << " / " << count_hits() << " hits" << std::endl;
+
+        // Circles near a 4 x 4 wall, every edge tested with check_circle_segment against one hit mask of all four
+        const CollisionBounds wall = CollisionBounds::create_wall({ 4.0f, 4.0f }, 0.3f);
+        const std::vector<LineSegment>& edges = wall.wall->edges;
+        const glm::vec2 wall_position(0.0f);
+        std::vector<glm::vec2> circles(n);
+        std::uniform_real_distribution<float> near(-3.5f, 3.5f);
+        for (glm::vec2& position : circles) position = { near(rng), near(rng) };
+        const CircleCollider circle{ loco_radius };
+
+        size_t edge_hits = 0;
+        double edge_us = _best_time_us(20, [&]() {
+            edge_hits = 0;
+            for (const glm::vec2& position : circles) {
+                for (const LineSegment& edge : edges) {
+                    glm::vec2 normal;
+                    float penetration;
+                    edge_hits += CollisionSystem::check_circle_segment(circle, position, edge, wall_position, normal, penetration);
+                }
+            }
+        });
+        _print_throughput("circle-wall, check_circle_segment per edge", n, edge_us);
+
+        size_t mask_hits = 0;
+        double mask_us = _best_time_us(20, [&]() {
+            mask_hits = 0;
+            for (const glm::vec2& position : circles) {
+                uint32_t mask = CollisionKernels::circle_segments(position, circle.radius, edges.data(), edges.size(), wall_position);
+                for (; mask; mask &= mask - 1) mask_hits++;
+            }
+        });
+        _print_throughput("circle-wall, circle_segments hit mask", n, mask_us);
+        std::cout << "  " << edge_hits << " / " << mask_hits << " edge hits" << std::endl;
+    }
+
+    // check_collisions on 1 to N threads over one seeded scene with walls, trees and moving circles. Also the
+    // determinism check: every thread count has to give the contacts of the single-threaded run bit for bit.
+    inline void collision_threading() {
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> random(-200.0f, 200.0f);
+        const size_t n = 20000;
+
+        MapManager::get_instance().load_maps();
+        Registry& world = MapManager::get_instance().get_active_registry();
+        world.clear_all_components();
+        for (size_t i = 0; i < n; i++) {
+            Entity e = Entity();
+            world.motions.emplace(e).position = { random(rng), random(rng) };
+            if (i % 10 == 0) {
+                world.collision_bounds.emplace(e, CollisionBounds::create_wall({ 4.0f + i % 7, 1.0f }, 0.1f * (i % 5)));
+                world.walls.emplace(e);
+                world.teams.emplace(e).team_id = TEAM_ID::NEUTRAL;
+            } else if (i % 10 == 1) {
+                world.collision_bounds.emplace(e, CollisionBounds::create_circle(1.5f));
+                world.static_objects.emplace(e);
+                world.teams.emplace(e).team_id = TEAM_ID::NEUTRAL;
+            } else {
+                world.collision_bounds.emplace(e, CollisionBounds::create_circle(0.5f + 0.1f * (i % 6)));
+                world.teams.emplace(e).team_id = (TEAM_ID)(i % 2);
+            }
+            world.near_players.emplace(e);
+        }
+
+        auto same_contacts = [](const std::vector<CollisionSystem::Contact>& left, const std::vector<CollisionSystem::Contact>& right) {
+            if (left.size() != right.size()) return false;
+            for (size_t i = 0; i < left.size(); i++) {
+                if (left[i].a.get_id() != right[i].a.get_id() || left[i].b.get_id() != right[i].b.get_id()
+                    || std::memcmp(&left[i].normal, &right[i].normal, sizeof(glm::vec2)) != 0
+                    || std::memcmp(&left[i].penetration, &right[i].penetration, sizeof(float)) != 0
+                    || std::memcmp(&left[i].time, &right[i].time, sizeof(float)) != 0) {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        JobSystem* previous = JobSystem::get();
+        JobSystem::set_instance(nullptr);
+        double single = _best_time_us(10, [&]() { CollisionSystem::check_collisions(); });
+        const std::vector<CollisionSystem::Contact> reference = CollisionSystem::contacts();
+        _print_result("check_collisions, no job system", n, single);
+
+        // 2, 4 and 8 threads run even on fewer cores, so the determinism check always has several workers
+        const unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<unsigned int> thread_counts = { 1, 2, 4, 8 };
+        for (unsigned int threads = 16; threads < hardware; threads *= 2) thread_counts.push_back(threads);
+        if (hardware > 8) thread_counts.push_back(hardware);
+
+        bool deterministic = true;
+        for (unsigned int threads : thread_counts) {
+            JobSystem jobs(threads - 1);
+            JobSystem::set_instance(&jobs);
+            double us = _best_time_us(10, [&]() { CollisionSystem::check_collisions(); });
+            const bool same = same_contacts(reference, CollisionSystem::contacts());
+            deterministic = deterministic && same;
+            JobSystem::set_instance(nullptr);
+            _print_result("check_collisions, " + std::to_string(threads) + " threads", n, us);
+            std::cout << std::left << std::setw(44) << "  speedup, contacts" << std::right << std::setw(8)
+                << std::fixed << std::setprecision(2) << single / us << "x " << (same ? "identical" : "DIFFERENT") << std::endl;
+        }
+        std::cout << "  " << reference.size() << " contacts, "
+            << (deterministic ? "deterministic" : "NOT deterministic") << " across thread counts" << std::endl;
+        JobSystem::set_instance(previous);
+        CollisionSystem::contacts().clear();
+        world.clear_all_components();
+    }
+
+    // Projectiles fired at a thin wall for a quarter of a second at several tick rates, with and without
+    // ContinuousCollision. Counts the projectiles that got through the wall and times the collision passes.
+    inline void projectile_tunneling() {
+        const size_t n = 2000;
+        const float speed = 600.0f;
+        const float duration = 0.25f;
+
+        MapManager::get_instance().load_maps();
+        Registry& world = MapManager::get_instance().get_active_registry();
+
+        for (int tick_rate : { 10, 30, 60, 120 }) {
+            for (int continuous = 0; continuous < 2; continuous++) {
+                world.clear_all_components();
+                Entity wall = Entity();
+                world.motions.emplace(wall).position = { 0.0f, 0.0f };
+                world.collision_bounds.emplace(wall, CollisionBounds::create_wall({ 0.2f, 2.0f * n }, 0.0f));
+                world.walls.emplace(wall);
+                world.teams.emplace(wall).team_id = TEAM_ID::NEUTRAL;
+                world.near_players.emplace(wall);
+
+                std::vector<Entity> projectiles;
+                for (size_t i = 0; i < n; i++) {
+                    Entity e = Entity();
+                    Motion& motion = world.motions.emplace(e);
+                    // Staggered starts, so the projectiles are at every phase of a step when they reach the wall
+                    motion.position = { -50.0f - 0.37f * (i % 97), float(i) - 0.5f * n };
+                    motion.velocity = { speed, 0.0f };
+                    world.collision_bounds.emplace(e, CollisionBounds::create_circle(0.2f));
+                    world.projectiles.emplace(e);
+                    world.teams.emplace(e).team_id = TEAM_ID::FRIENDLY;
+                    world.near_players.emplace(e);
+                    if (continuous) world.continuous_collisions.emplace(e).start = motion.position;
+                    projectiles.push_back(e);
+                }
+
+                const float dt = 1.0f / tick_rate;
+                double us = 0.0;
+                for (int tick = 0; tick < int(duration * tick_rate); tick++) {
+                    world.view<Motion>().each([&](Entity e, Motion& motion) {
+                        if (ContinuousCollision* swept = world.continuous_collisions.try_get(e)) swept->start = motion.position;
+                        motion.position += motion.velocity * dt;
+                    });
+                    auto start = std::chrono::high_resolution_clock::now();
+                    CollisionSystem::check_collisions();
+                    auto end = std::chrono::high_resolution_clock::now();
+                    us += std::chrono::duration<double, std::micro>(end - start).count();
+                    CollisionSystem::handle_collisions();
+                    world.flush_commands();
+                }
+
+                size_t through = 0;
+                for (Entity e : projectiles) {
+                    if (world.valid(e) && world.motions.get(e).position.x > 0.0f) through++;
+                }
+                _print_result(std::to_string(tick_rate) + " Hz, " + (continuous ? "swept" : "discrete"), n, us);
+                std::cout << "  " << through << " of " << n << " through the wall" << std::endl;
+            }
+        }
+        CollisionSystem::contacts().clear();
+        world.clear_all_components();
+    }
+
+    // Line of sight rays and overlap probes through the collision world queries against a scan of every collider,
+    // like the AI vision and avoidance code did before. Both have to find the same hits.
+    inline void collision_queries() {
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> random(-200.0f, 200.0f);
+        std::uniform_real_distribution<float> random_angle(0.0f, 6.2831853f);
+        const size_t n = 20000;
+        const size_t queries = 2000;
+
+        MapManager::get_instance().load_maps();
+        Registry& world = MapManager::get_instance().get_active_registry();
+        world.clear_all_components();
+        std::vector<Entity> colliders;
+        for (size_t i = 0; i < n; i++) {
+            Entity e = Entity();
+            world.motions.emplace(e).position = { random(rng), random(rng) };
+            if (i % 10 == 0) {
+                world.collision_bounds.emplace(e, CollisionBounds::create_wall({ 4.0f + i % 7, 1.0f }, 0.1f * (i % 5)));
+                world.walls.emplace(e);
+            } else if (i % 10 == 1) {
+                world.collision_bounds.emplace(e, CollisionBounds::create_circle(1.5f));
+                world.static_objects.emplace(e);
+            } else {
+                world.collision_bounds.emplace(e, CollisionBounds::create_circle(0.5f + 0.1f * (i % 6)));
+            }
+            world.teams.emplace(e).team_id = TEAM_ID::NEUTRAL;
+            world.near_players.emplace(e);
+            colliders.push_back(e);
+        }
+        CollisionSystem::check_collisions();
+
+        // Rays up to 30 units long, the distance at which enemies start chasing
+        std::vector<glm::vec2> starts, ends;
+        for (size_t i = 0; i < queries; i++) {
+            glm::vec2 start(random(rng), random(rng));
+            float angle = random_angle(rng);
+            starts.push_back(start);
+            ends.push_back(start + 30.0f * glm::vec2(std::cos(angle), std::sin(angle)));
+        }
+        auto all = [](Entity) { return true; };
+
+        size_t scan_blocked = 0;
+        double scan_us = _best_time_us(3, [&]() {
+            scan_blocked = 0;
+            for (size_t i = 0; i < queries; i++) {
+                for (Entity e : colliders) {
+                    if (!world.walls.has(e) && !world.static_objects.has(e)) continue;
+                    float fraction;
+                    glm::vec2 normal;
+                    if (CollisionSystem::cast_collider(starts[i], ends[i] - starts[i], 0.0f, world.collision_bounds.get(e), world.motions.get(e).position, fraction, normal)) {
+                        scan_blocked++;
+                        break;
+                    }
+                }
+            }
+        });
+        size_t query_blocked = 0;
+        double query_us = _best_time_us(3, [&]() {
+            query_blocked = 0;
+            for (size_t i = 0; i < queries; i++) {
+                if (!CollisionSystem::line_of_sight(starts[i], ends[i], CollisionSystem::QueryScope::Static, all)) query_blocked++;
+            }
+        });
+        _print_result("line of sight, scan of all colliders", queries, scan_us);
+        _print_result("line of sight, raycast", queries, query_us);
+        std::cout << "  " << query_blocked << " blocked, " << (scan_blocked == query_blocked ? "same as the scan" : "DIFFERENT from the scan") << std::endl;
+
+        size_t scan_found = 0;
+        scan_us = _best_time_us(3, [&]() {
+            scan_found = 0;
+            for (size_t i = 0; i < queries; i++) {
+                for (Entity e : colliders) {
+                    if (CollisionSystem::overlap_collider(starts[i], 4.0f, world.collision_bounds.get(e), world.motions.get(e).position)) scan_found++;
+                }
+            }
+        });
+        size_t query_found = 0;
+        query_us = _best_time_us(3, [&]() {
+            query_found = 0;
+            for (size_t i = 0; i < queries; i++) {
+                CollisionSystem::overlap_circle(starts[i], 4.0f, CollisionSystem::QueryScope::All, all, [&](Entity) { query_found++; });
+            }
+        });
+        _print_result("overlap, scan of all colliders", queries, scan_us);
+        _print_result("overlap, overlap_circle", queries, query_us);
+        std::cout << "  " << query_found << " overlaps, " << (scan_found == query_found ? "same as the scan" : "DIFFERENT from the scan") << std::endl;
+
+        CollisionSystem::contacts().clear();
+        world.clear_all_components();
+    }
+
+    // parallel_for on 1 to N threads over a narrow phase like workload: every body tests 64 others for overlap
+    inline void job_system_scaling() {
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> random(-100.0f, 100.0f);
+        const size_t n = 100000, neighbours = 64;
+        std::vector<glm::vec2> positions(n);
+        for (glm::vec2& position : positions) position = { random(rng), random(rng) };
+        std::vector<int> overlaps(n);
+
+        auto test_range = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                int count = 0;
+                for (size_t k = 1; k <= neighbours; k++) {
+                    count += glm::length(positions[(i + k * 131) % n] - positions[i]) < 2.0f;
+                }
+                overlaps[i] = count;
+            }
+        };
+
+        double single = _best_time_us(5, [&]() { test_range(0, n); });
+        _print_throughput("overlap tests, plain loop", n, single);
+
+        // Powers of two up to the hardware threads, and all of them
+        const unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<unsigned int> thread_counts;
+        for (unsigned int threads = 1; threads < hardware; threads *= 2) thread_counts.push_back(threads);
+        thread_counts.push_back(hardware);
+
+        for (unsigned int threads : thread_counts) {
+            JobSystem jobs(threads - 1);
+            double us = _best_time_us(5, [&]() { jobs.parallel_for(0, n, 256, test_range); });
+            _print_throughput("overlap tests, " + std::to_string(threads) + " threads", n, us);
+            std::cout << std::left << std::setw(44) << "  speedup over the plain loop" << std::right << std::setw(8)
+                << std::fixed << std::setprecision(2) << single / us << "x" << std::endl;
+        }
+    }
+}
@@ -5,6 +5,8 @@
 #include <utils/FileSystem.hpp>
 #include <utils/Timer.h>
 #include <utils/Common.hpp>
+#include <utils/JobSystem.hpp>
+#include <utils/Profiler.hpp>
 #include <renderer/Renderer.hpp>
 #include <renderer/Camera.hpp>
 #include <renderer/SkyboxTexture.hpp>
@@ -27,6 +29,7 @@
 #include <utils/CalladaTokenizer.hpp>
 
 #include <iomanip>
+#include <sstream>
 #include <vector>
 #include <unordered_map>
 #include <memory>
@@ -35,6 +38,9 @@
 #define MAX_LIGHTS 25
 
 class Application {
+    // Declared first so that it outlives everything that may queue jobs, see JobSystem::get()
+    JobSystem m_job_system;
+
     Renderer* m_renderer = nullptr;
     Camera m_camera;
 
@@ -83,6 +89,16 @@ class Application {
     std::string m_window_name = "Seekers";
 
     std::unordered_map<unsigned int, AnimatedModel*> m_models;
+    std::vector<std::pair<Entity, AnimatedModel*>> m_models_to_update; // scratch space of _update_models
+
+    // Model matrix and u_scale of each wall by entity id, only rebuilt for walls whose Motion changed, see _draw_walls
+    struct WallDrawData {
+        glm::mat4 model;
+        glm::vec3 scale;
+    };
+    std::unordered_map<unsigned int, WallDrawData> m_wall_draw_data;
+    unsigned int m_wall_draw_registry = 0; // Registry::id()
+    ChangeVersion m_wall_draw_version = 0;
     bool m_player_was_in_rest = false;
 
     std::unique_ptr<Menu> main_menu;
@@ -92,6 +108,8 @@ class Application {
     float m_frame_rate = 0.0f;
 public:
     Application() : m_light_pos(1.0f, 1.0f, 2.0f) {
+        JobSystem::set_instance(&m_job_system);
+
         // Setup
         m_renderer = &Renderer::get_instance();
         m_renderer->init(
@@ -392,6 +410,10 @@ public:
             }
             float delta_time_s = delta_time * 0.000001f;
             m_frame_rate = 1.0f / delta_time_s;
+
+            // The frame zone covers the work of the frame, not the wait for the 60 fps frame time above
+            Profiler::end_frame();
+            PROFILE_ZONE("frame");
             // m_renderer->set_title(m_window_name + " | FPS: " + std::to_string(m_frame_rate));
             time_of_last_frame = float(timer.GetTime());
 
@@ -624,15 +646,21 @@ public:
             _draw_projectiles();
             _draw_light_orbs();
 
-            for (auto& id : m_to_be_updated_and_drawn) {
-                auto kv = m_models.find(id);
-                if (kv == m_models.end() || kv->second == nullptr) { continue; }
-                kv->second->draw();
+            {
+                PROFILE_ZONE("draw models");
+                for (auto& id : m_to_be_updated_and_drawn) {
+                    auto kv = m_models.find(id);
+                    if (kv == m_models.end() || kv->second == nullptr) { continue; }
+                    kv->second->draw();
+                }
             }
 
             _draw_hud();
 
-            m_renderer->end_draw();
+            {
+                PROFILE_ZONE("end_draw");
+                m_renderer->end_draw();
+            }
 
             if (Globals::is_3d_mode) {
                 // m_renderer->lock_cursor();
@@ -1200,6 +1228,7 @@ private:
     }
 
     void _draw_light_orbs() {
+        PROFILE_ZONE("_draw_light_orbs");
         // Always skip the camera light :/
         m_light_orb->set_rotation_z(m_light_orb->get_rotation_z() + 0.05);
         for (unsigned int i = 0; i < m_light_positions.size(); ++i) {
@@ -1211,6 +1240,7 @@ private:
     }
 
     void _draw_map_and_skybox() {
+        PROFILE_ZONE("_draw_map_and_skybox");
         // Render skybox.
         float size = Common::max_of(MAP_WIDTH, MAP_HEIGHT);
         size += 500;
@@ -1250,6 +1280,7 @@ private:
     }
 
     void _draw_walls() {
+        PROFILE_ZONE("_draw_walls");
         m_wall_shader->set_uniform_mat4f("u_view_project", m_camera.get_view_project_matrix());
         m_wall_shader->set_uniform_3f("u_object_color", { 0.5, 0.2, 1 });
         m_wall_shader->set_uniform_1i("u_use_repeating_pattern", true);
@@ -1268,20 +1299,34 @@ private:
         m_wall_shader->set_uniform_3f_array("u_light_colours", *m_light_colours.data(), m_light_colours.size());
 
         auto& reg = MapManager::get_instance().get_active_registry();
-        for (auto& entity : reg.walls.entities) {
-            if (!reg.motions.has(entity)) { continue; }
-            auto& motion = reg.motions.get(entity);
-            if (glm::distance(motion.position, glm::vec2(m_camera.get_position())) > Globals::static_render_distance) { continue; }
+        if (reg.id() != m_wall_draw_registry) {
+            m_wall_draw_data.clear();
+            m_wall_draw_registry = reg.id();
+            m_wall_draw_version = 0;
+        }
+        // Walls never move after they are placed, so this only runs for new walls and after a map switch or restore
+        const ChangeVersion since = m_wall_draw_version;
+        m_wall_draw_version = reg.change_version();
+        reg.view<Wall, Motion>().changed_since(since).each([&](Entity entity, Wall&, Motion& motion) {
             glm::vec3 wall_scale = glm::vec3(motion.scale, 10.0f);
-            m_wall_shader->set_uniform_3f("u_scale", {wall_scale.x / 8, wall_scale.z / 8, wall_scale.y});
-            m_wall_shader->set_uniform_mat4f(
-                "u_model",
+            m_wall_draw_data[entity] = {
                 Transform::create_model_matrix(
                     glm::vec3(motion.position, wall_scale.z / 2),
                     { 0, 0, motion.angle },
                     wall_scale
-                )
-            );
+                ),
+                {wall_scale.x / 8, wall_scale.z / 8, wall_scale.y}
+            };
+        });
+
+        for (auto& entity : reg.walls.entities) {
+            const Motion* motion = reg.motions.try_get(entity);
+            if (!motion) { continue; }
+            if (glm::distance(motion->position, glm::vec2(m_camera.get_position())) > Globals::static_render_distance) { continue; }
+            auto draw_data = m_wall_draw_data.find(entity);
+            if (draw_data == m_wall_draw_data.end()) { continue; }
+            m_wall_shader->set_uniform_3f("u_scale", draw_data->second.scale);
+            m_wall_shader->set_uniform_mat4f("u_model", draw_data->second.model);
             m_renderer->draw(m_cube_mesh, *m_wall_shader);
         }
 
@@ -1329,6 +1374,7 @@ private:
     }
 
     void _draw_projectiles() {
+        PROFILE_ZONE("_draw_projectiles");
         auto& reg = MapManager::get_instance().get_active_registry();
 
         for (const auto& entity : reg.projectiles.entities) {
@@ -1355,6 +1401,7 @@ private:
     }
 
     void _draw_health_bars() {
+        PROFILE_ZONE("_draw_health_bars");
         // Render Health Bars
         auto& reg = MapManager::get_instance().get_active_registry();
         auto& player_motion = reg.motions.get(reg.player);
@@ -1538,7 +1585,72 @@ private:
         m_renderer->draw(m_square_mesh, *m_hud_health_shader);
     }
 
+    // Rolling min / avg / p99 per profiler zone in milliseconds, toggled with F3
+    void _draw_profiler() {
+        const float width = float(m_renderer->get_window_width());
+        const float height = float(m_renderer->get_window_height());
+        const float scale = width / (1920.f * 3.0f);
+        const float line_height = height / 40.0f;
+        const glm::vec3 colour = {1, 1, 1};
+
+        auto format_ms = [](float ms) {
+            std::ostringstream text;
+            text << std::fixed << std::setprecision(2) << ms;
+            return text.str();
+        };
+
+        float y = height - height / 20.0f;
+        FontStuff& font_monkey = FontStuff::get_instance();
+        font_monkey.render_text("zone   min / avg / p99 ms", width / 40.0f, y, scale, colour);
+        const size_t MAX_ROWS = 24;
+        const auto rows = Profiler::summaries();
+        for (size_t i = 0; i < rows.size() && i < MAX_ROWS; i++) {
+            y -= line_height;
+            const auto& row = rows[i];
+            font_monkey.render_text(
+                row.name + "   " + format_ms(row.min_ms) + " / " + format_ms(row.avg_ms) + " / " + format_ms(row.p99_ms),
+                width / 40.0f, y, scale, colour
+            );
+        }
+    }
+
+    // The largest containers of the active registry by reserved memory, the right column of the debug overlays
+    void _draw_memory() {
+        const float width = float(m_renderer->get_window_width());
+        const float height = float(m_renderer->get_window_height());
+        const float scale = width / (1920.f * 3.0f);
+        const float line_height = height / 40.0f;
+        const float x = width / 2.0f;
+        const glm::vec3 colour = {1, 1, 1};
+
+        auto format_kb = [](size_t bytes) {
+            std::ostringstream text;
+            text << std::fixed << std::setprecision(1) << bytes / 1024.0;
+            return text.str();
+        };
+
+        const Registry& reg = MapManager::get_instance().get_active_registry();
+        auto rows = reg.memory_report();
+        std::sort(rows.begin(), rows.end(), [](const ContainerMemory& a, const ContainerMemory& b) { return a.usage.reserved() > b.usage.reserved(); });
+        const MemoryUsage total = reg.total_memory();
+
+        float y = height - height / 20.0f;
+        FontStuff& font_monkey = FontStuff::get_instance();
+        font_monkey.render_text("registry   " + format_kb(total.used()) + " / " + format_kb(total.reserved()) + " KB used / reserved", x, y, scale, colour);
+        const size_t MAX_ROWS = 24;
+        for (size_t i = 0; i < rows.size() && i < MAX_ROWS; i++) {
+            y -= line_height;
+            const auto& row = rows[i];
+            font_monkey.render_text(
+                std::string(row.name) + " x" + std::to_string(row.usage.count) + "   "
+                    + format_kb(row.usage.used()) + " / " + format_kb(row.usage.reserved()) + (row.shared ? " (shared)" : ""),
+                x, y, scale, colour
+            );
+        }
+    }
+
     void _draw_hud() {
+        PROFILE_ZONE("_draw_hud");
         auto& reg = MapManager::get_instance().get_active_registry();
         auto& player_loco = reg.locomotion_stats.get(reg.player);
         float health_percentage = player_loco.health / player_loco.max_health;
@@ -1595,6 +1707,13 @@ private:
         }
         FontStuff::get_instance().render_text("fps: " + std::to_string(int(m_frame_rate)), m_renderer->get_window_width() - m_renderer->get_window_width() / 20.0f, m_renderer->get_window_height() - m_renderer->get_window_height() / 20.0f, float(m_renderer->get_window_width()) / (1920.f * 3.0f), fps_colour);
 
+        if (Globals::show_profiler) {
+            _draw_profiler();
+        }
+        if (Globals::show_memory) {
+            _draw_memory();
+        }
+
         m_renderer->enable_depth_test();
 
 
@@ -1609,128 +1728,154 @@ private:
     }
 
     void _update_models() {
+        PROFILE_ZONE("_update_models");
         auto& reg = MapManager::get_instance().get_active_registry();
+
+        // Models of dead entities are dropped first, so that the parallel part below never changes m_models
+        m_models_to_update.clear();
+        std::pair<Entity, AnimatedModel*> player_model(Entity::null(), nullptr);
         for (auto& id : m_to_be_updated_and_drawn) {
             if (id < 0) { continue; }
-            auto& model = m_models[id];
-            if (model == nullptr) {
+            auto kv = m_models.find(id);
+            if (kv == m_models.end() || kv->second == nullptr) {
                 continue;
             }
             Entity entity = reinterpret_cast<Entity&>(id);
             if (!reg.motions.has(entity)) {
-                delete model;
-                m_models[id] = nullptr;
+                delete kv->second;
+                kv->second = nullptr;
                 continue;
             }
-            auto& motion = reg.motions.get(id);
+            if (entity.get_id() == reg.player.get_id()) {
+                player_model = { entity, kv->second };
+            } else {
+                m_models_to_update.push_back({ entity, kv->second });
+            }
+        }
 
-            auto angle = std::fmod(motion.angle, 2 * PI);
-            if (angle < 0) {
-                angle += 2 * PI;
+        // The player's model updates m_player_was_in_rest and Globals::is_getting_up, so it goes first on this thread.
+        // Every other model reads the registry and those flags and changes nothing but its own animator.
+        reg.unshare_components<Motion, DeathCooldown, InRest, StaggerCooldown, InDodge, AttackCooldown>();
+        if (player_model.second) {
+            _update_model(reg, player_model.first, player_model.second);
+        }
+        JobSystem::parallel_for_each_chunk(0, m_models_to_update.size(), 4, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                _update_model(reg, m_models_to_update[i].first, m_models_to_update[i].second);
             }
-            auto velocity_angle = _vector_to_angle(motion.velocity);
-            auto dot_between_view_velo_directions = glm::dot(
-                glm::normalize(
-                    glm::vec2(Transform::create_rotation_matrix({0, 0, angle}) * glm::vec4(1, 0, 0, 0))
-                ),
-                glm::normalize(motion.velocity)
-            );
-            dot_between_view_velo_directions = glm::clamp(dot_between_view_velo_directions, -0.9999999f, 0.9999999f);
-            float angle_between_view_and_velo = std::acos(dot_between_view_velo_directions);
-
-            // bool is_dodging = false;
-            bool rotate_to_velocity_dir = false;
-            bool rotate_opposite_to_velocity_dir = false;
-            bool is_zombie = model->get_name() == "Zombie Grunt.dae";
-            // const float buffer_time = 0.45f;
-            // const float buffer_time = 0.25f;
-            const float buffer_time = 0.5f;
-            if (reg.death_cooldowns.has(entity)) {
-                model->force_play_animation("Dying.dae", -1, false, true);
-            } else if (reg.in_rests.has(entity) && reg.player.get_id() == entity.get_id()) {
-                if (!m_player_was_in_rest) {
-                    model->force_play_animation("Stand Up.dae", -1, false, true, true);
-                    m_player_was_in_rest = true;
-                }
-            } else if (
-                Globals::is_getting_up &&
-                model->get_current_animation_id() == model->get_animation_id("Stand Up.dae") &&
-                model->get_portion_complete_of_curr_animation() > 0.95f
-            ) {
-                if (m_player_was_in_rest) {
-                    model->force_play_animation("Sitting.dae");
-                    model->force_play_animation("Stand Up.dae", -1, false, true);
-                    m_player_was_in_rest = false;
-                } else {
-                    Globals::is_getting_up = false;
-                }
-            } else if (reg.stagger_cooldowns.has(entity)) {
-                const auto& cooldown = reg.stagger_cooldowns.get(entity);
-                model->force_play_animation("Stagger.dae", cooldown.timer + buffer_time);
-            } else if (reg.death_cooldowns.has(reg.player)) {
-                const auto& cooldown = reg.death_cooldowns.get(reg.player);
-                model->force_play_animation("Dance.dae", cooldown.timer + 2.0f * buffer_time);
-            } else {
-                if (reg.in_dodges.has(entity)) {
-                    const auto& dodge = reg.in_dodges.get(entity);
-                    model->force_play_animation("Roll.dae", dodge.duration + buffer_time, false, true);
-                }
+        });
+    }
 
-                if (reg.attack_cooldowns.has(entity)) {
-                    const auto& cooldown = reg.attack_cooldowns.get(entity);
-                    if (glm::length(motion.velocity) > 0.0f) {
-                        model->play_animation("Running Attack.dae", cooldown.timer + buffer_time, false, true);
-                    } else {
-                        model->play_animation("Standing Attack.dae", cooldown.timer + buffer_time, false, true);
-                    }
-                }
+    void _update_model(Registry& reg, Entity entity, AnimatedModel* model) {
+        auto& motion = reg.motions.get(entity);
 
-                if (glm::length(motion.velocity) > 0.0f) {
-                    // const auto& speed = glm::length(motion.velocity);
-                    if (angle_between_view_and_velo < PI / 3 || is_zombie) {
-                        model->play_animation("Forward.dae", 0.7f);
-                    } else if (angle_between_view_and_velo > 2 * PI / 3) {
-                        model->play_animation("Backward.dae", 0.7f);
-                    } else if (
-                        (velocity_angle - angle < PI && velocity_angle - angle >= 0)
-                        || velocity_angle - angle < -PI && velocity_angle - angle < 0) {
-                        model->play_animation("Left.dae", 0.75f);
-                    } else {
-                        model->play_animation("Right.dae", 0.75f);
-                    }
+        auto angle = std::fmod(motion.angle, 2 * PI);
+        if (angle < 0) {
+            angle += 2 * PI;
+        }
+        auto velocity_angle = _vector_to_angle(motion.velocity);
+        auto dot_between_view_velo_directions = glm::dot(
+            glm::normalize(
+                glm::vec2(Transform::create_rotation_matrix({0, 0, angle}) * glm::vec4(1, 0, 0, 0))
+            ),
+            glm::normalize(motion.velocity)
+        );
+        dot_between_view_velo_directions = glm::clamp(dot_between_view_velo_directions, -0.9999999f, 0.9999999f);
+        float angle_between_view_and_velo = std::acos(dot_between_view_velo_directions);
+
+        // bool is_dodging = false;
+        bool rotate_to_velocity_dir = false;
+        bool rotate_opposite_to_velocity_dir = false;
+        bool is_zombie = model->get_name() == "Zombie Grunt.dae";
+        // const float buffer_time = 0.45f;
+        // const float buffer_time = 0.25f;
+        const float buffer_time = 0.5f;
+        if (reg.death_cooldowns.has(entity)) {
+            model->force_play_animation("Dying.dae", -1, false, true);
+        } else if (reg.in_rests.has(entity) && reg.player.get_id() == entity.get_id()) {
+            if (!m_player_was_in_rest) {
+                model->force_play_animation("Stand Up.dae", -1, false, true, true);
+                m_player_was_in_rest = true;
+            }
+        } else if (
+            reg.player.get_id() == entity.get_id() &&
+            Globals::is_getting_up &&
+            model->get_current_animation_id() == model->get_animation_id("Stand Up.dae") &&
+            model->get_portion_complete_of_curr_animation() > 0.95f
+        ) {
+            if (m_player_was_in_rest) {
+                model->force_play_animation("Sitting.dae");
+                model->force_play_animation("Stand Up.dae", -1, false, true);
+                m_player_was_in_rest = false;
+            } else {
+                Globals::is_getting_up = false;
+            }
+        } else if (reg.stagger_cooldowns.has(entity)) {
+            const auto& cooldown = reg.stagger_cooldowns.get(entity);
+            model->force_play_animation("Stagger.dae", cooldown.timer + buffer_time);
+        } else if (reg.death_cooldowns.has(reg.player)) {
+            const auto& cooldown = reg.death_cooldowns.get(reg.player);
+            model->force_play_animation("Dance.dae", cooldown.timer + 2.0f * buffer_time);
+        } else {
+            if (reg.in_dodges.has(entity)) {
+                const auto& dodge = reg.in_dodges.get(entity);
+                model->force_play_animation("Roll.dae", dodge.duration + buffer_time, false, true);
+            }
 
+            if (reg.attack_cooldowns.has(entity)) {
+                const auto& cooldown = reg.attack_cooldowns.get(entity);
+                if (glm::length(motion.velocity) > 0.0f) {
+                    model->play_animation("Running Attack.dae", cooldown.timer + buffer_time, false, true);
                 } else {
-                    model->play_animation("default0");
+                    model->play_animation("Standing Attack.dae", cooldown.timer + buffer_time, false, true);
                 }
             }
 
-
-            const auto current_anim_id = model->get_current_animation_id();
-            if (glm::length(motion.velocity) > 0.001f) {
-
-                if (current_anim_id == model->get_animation_id("Roll.dae")) {
-                    rotate_to_velocity_dir = true;
-                } else if (current_anim_id == model->get_animation_id("Running Attack.dae")) {
-                    // rotate_to_velocity_dir = true;
-                } else if (current_anim_id == model->get_animation_id("Forward.dae")) {
-                    rotate_to_velocity_dir = true;
-                } else if (current_anim_id == model->get_animation_id("Backward.dae")) {
-                    rotate_opposite_to_velocity_dir = true;
+            if (glm::length(motion.velocity) > 0.0f) {
+                // const auto& speed = glm::length(motion.velocity);
+                if (angle_between_view_and_velo < PI / 3 || is_zombie) {
+                    model->play_animation("Forward.dae", 0.7f);
+                } else if (angle_between_view_and_velo > 2 * PI / 3) {
+                    model->play_animation("Backward.dae", 0.7f);
+                } else if (
+                    (velocity_angle - angle < PI && velocity_angle - angle >= 0)
+                    || velocity_angle - angle < -PI && velocity_angle - angle < 0) {
+                    model->play_animation("Left.dae", 0.75f);
+                } else {
+                    model->play_animation("Right.dae", 0.75f);
                 }
 
+            } else {
+                model->play_animation("default0");
             }
-            model->set_position(glm::vec3(motion.position, 0.0f));
+        }
 
-            if (rotate_to_velocity_dir) {
-                model->set_rotation_z(velocity_angle);
-            } else if (rotate_opposite_to_velocity_dir) {
-                model->set_rotation_z(velocity_angle - PI);
-            } else {
-                model->set_rotation_z(motion.angle);
+
+        const auto current_anim_id = model->get_current_animation_id();
+        if (glm::length(motion.velocity) > 0.001f) {
+
+            if (current_anim_id == model->get_animation_id("Roll.dae")) {
+                rotate_to_velocity_dir = true;
+            } else if (current_anim_id == model->get_animation_id("Running Attack.dae")) {
+                // rotate_to_velocity_dir = true;
+            } else if (current_anim_id == model->get_animation_id("Forward.dae")) {
+                rotate_to_velocity_dir = true;
+            } else if (current_anim_id == model->get_animation_id("Backward.dae")) {
+                rotate_opposite_to_velocity_dir = true;
             }
 
-            model->update();
         }
+        model->set_position(glm::vec3(motion.position, 0.0f));
+
+        if (rotate_to_velocity_dir) {
+            model->set_rotation_z(velocity_angle);
+        } else if (rotate_opposite_to_velocity_dir) {
+            model->set_rotation_z(velocity_angle - PI);
+        } else {
+            model->set_rotation_z(motion.angle);
+        }
+
+        model->update();
     }
 
     void _add_resume_to_menu() {
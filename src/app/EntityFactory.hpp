@@ -2,12 +2,108 @@
 
 #include <ecs/Registry.hpp>
 #include <ecs/Entity.hpp>
+#include <ecs/Prefab.hpp>
 #include <components/Components.hpp>
 #include <utils/Common.hpp>
 
 #include <glm/glm.hpp>
+#include <vector>
 
 namespace EntityFactory {
+    // Creates one entity per position with copies of the prefab's components and its Motion moved to the position.
+    // setup(entity, motion, i) then runs for each new entity, for whatever differs between the instances.
+    template <typename Setup>
+    inline std::vector<Entity> spawn_batch(Registry& registry, const Prefab& prefab, const std::vector<glm::vec2>& positions, Setup setup) {
+        assert(prefab.has<Motion>() && "spawn_batch places the Motion of the prefab");
+        std::vector<Entity> entities;
+        entities.reserve(positions.size());
+        for (size_t i = 0; i < positions.size(); i++) {
+            entities.push_back(Entity());
+        }
+
+        // The batch fills the motions contiguously from here
+        const size_t first_motion = registry.motions.size();
+        prefab.instantiate(registry, entities);
+        for (size_t i = 0; i < entities.size(); i++) {
+            Motion& motion = registry.motions.components[first_motion + i];
+            motion.position = positions[i];
+            setup(entities[i], motion, i);
+        }
+        return entities;
+    }
+
+    inline std::vector<Entity> spawn_batch(Registry& registry, const Prefab& prefab, const std::vector<glm::vec2>& positions) {
+        return spawn_batch(registry, prefab, positions, [](Entity, Motion&, size_t) {});
+    }
+
+    inline const Prefab& tree_prefab() {
+        static const Prefab prefab = []() {
+            Motion motion;
+            motion.scale = glm::vec2(4.0f, 4.0f);
+            Team team;
+            team.team_id = TEAM_ID::NEUTRAL;
+            StaticObject tree;
+            tree.type = STATIC_OBJECT_TYPE::TREE;
+
+            // Use circle collider for tree
+            Prefab tree_prefab("tree");
+            tree_prefab.with(motion).with(team).with(tree).with(CollisionBounds::create_circle(Common::max_of(motion.scale) / 2));
+            return tree_prefab;
+        }();
+        return prefab;
+    }
+
+    inline const Prefab& rock_prefab() {
+        static const Prefab prefab = []() {
+            Motion motion;
+            motion.scale = glm::vec2(13.0f);
+            Team team;
+            team.team_id = TEAM_ID::NEUTRAL;
+            StaticObject rock;
+            rock.type = STATIC_OBJECT_TYPE::ROCK;
+
+            Prefab rock_prefab("rock");
+            rock_prefab.with(motion).with(team).with(rock).with(CollisionBounds::create_circle(Common::max_of(motion.scale) / 2));
+            return rock_prefab;
+        }();
+        return prefab;
+    }
+
+    // Without a collider, the wall collider depends on the length and angle of each wall, see spawn_walls
+    inline const Prefab& wall_prefab() {
+        static const Prefab prefab = []() {
+            Team team;
+            team.team_id = TEAM_ID::NEUTRAL;
+            Wall wall;
+            wall.type = WALL_TYPE::BRICK;
+
+            Prefab wall_prefab("wall");
+            wall_prefab.with(Motion()).with(team).with(wall);
+            return wall_prefab;
+        }();
+        return prefab;
+    }
+
+    inline std::vector<Entity> spawn_trees(Registry& registry, const std::vector<glm::vec2>& positions, const std::vector<float>& angles) {
+        return spawn_batch(registry, tree_prefab(), positions, [&](Entity, Motion& motion, size_t i) {
+            motion.angle = angles[i];
+        });
+    }
+
+    inline std::vector<Entity> spawn_walls(Registry& registry, const std::vector<glm::vec2>& positions, const std::vector<float>& angles, const std::vector<glm::vec2>& scales, bool collides = true) {
+        if (collides) {
+            registry.collision_bounds.reserve(registry.collision_bounds.size() + positions.size());
+        }
+        return spawn_batch(registry, wall_prefab(), positions, [&](Entity entity, Motion& motion, size_t i) {
+            motion.angle = angles[i];
+            motion.scale = scales[i];
+            // Use wall collider instead of AABB
+            if (collides) {
+                registry.collision_bounds.emplace(entity, CollisionBounds::create_wall(motion.scale, motion.angle));
+            }
+        });
+    }
+
     inline Entity create_player(Registry& registry, glm::vec2 position) {
         auto entity = Entity();
 
@@ -100,7 +196,7 @@ namespace EntityFactory {
         auto& enemy = registry.enemies.emplace(entity);
         enemy.type = enemy_type;
 
-        Entity enemy_weapon;
+        Entity enemy_weapon = Entity::null();
         if (enemy_type == ENEMY_TYPE::ZOMBIE) {
             enemy_weapon = EntityFactory::create_weapon(registry, position, 5.0f, 0.5f, WEAPON_TYPE::PUNCH);
         } else if (enemy_type == ENEMY_TYPE::ARCHER) {
@@ -127,6 +223,8 @@ namespace EntityFactory {
         //motion.velocity = attacker.aim * weapon.proj_speed + attacker_motion.velocity;
         motion.velocity = attacker.aim * weapon.proj_speed;
         motion.scale = glm::vec2(1.0f, 1.0f);  // Projectile size
+        // Fast enough to pass through a wall in one step at low frame rates
+        registry.continuous_collisions.emplace(entity).start = motion.position;
 
         auto& projectile = registry.projectiles.emplace(entity);
         projectile.damage = weapon.damage;
@@ -273,86 +371,19 @@ namespace EntityFactory {
     }
 
     inline Entity create_wall(Registry& registry, glm::vec2 position, float angle, glm::vec2 scale = glm::vec2(2.0f, 2.0f)) {
-        auto entity = Entity();
-
-        auto& motion = registry.motions.emplace(entity);
-        motion.position = position;
-        motion.angle = angle;
-        motion.scale = scale;
-
-        auto& team = registry.teams.emplace(entity);
-        team.team_id = TEAM_ID::NEUTRAL;
-
-        auto& wall = registry.walls.emplace(entity);
-        wall.type = WALL_TYPE::BRICK;
-
-        // // Use AABB collider for wall
-        // auto& bounds = registry.collision_bounds.emplace(entity,
-        //     CollisionBounds::create_aabb(motion.scale));
-
-        // Use wall collider instead of AABB
-        registry.collision_bounds.emplace(entity,
-            CollisionBounds::create_wall(motion.scale, motion.angle));
-
-        return entity;
+        return spawn_walls(registry, { position }, { angle }, { scale }).front();
     }
 
     inline Entity create_no_collision_wall(Registry& registry, glm::vec2 position, float angle, glm::vec2 scale = glm::vec2(2.0f, 2.0f)) {
-        auto entity = Entity();
-
-        auto& motion = registry.motions.emplace(entity);
-        motion.position = position;
-        motion.angle = angle;
-        motion.scale = scale;
-
-        auto& team = registry.teams.emplace(entity);
-        team.team_id = TEAM_ID::NEUTRAL;
-
-        auto& wall = registry.walls.emplace(entity);
-        wall.type = WALL_TYPE::BRICK;
-
-        return entity;
+        return spawn_walls(registry, { position }, { angle }, { scale }, false).front();
     }
 
     inline Entity create_tree(Registry& registry, glm::vec2 position, float angle = 0.0f) {
-        auto entity = Entity();
-
-        auto& motion = registry.motions.emplace(entity);
-        motion.position = position;
-        motion.scale = glm::vec2(4.0f, 4.0f);
-        motion.angle = angle;
-
-        auto& team = registry.teams.emplace(entity);
-        team.team_id = TEAM_ID::NEUTRAL;
-
-        auto& tree = registry.static_objects.emplace(entity);
-        tree.type = STATIC_OBJECT_TYPE::TREE;
-
-        // Use circle collider for tree
-        registry.collision_bounds.emplace(entity,
-            CollisionBounds::create_circle(Common::max_of(motion.scale) / 2));
-
-        return entity;
+        return spawn_trees(registry, { position }, { angle }).front();
     }
 
     inline Entity create_rock(Registry& registry, glm::vec2 position) {
-        auto entity = Entity();
-
-        auto& motion = registry.motions.emplace(entity);
-        motion.position = position;
-        motion.scale = glm::vec2(13.0f);
-
-        auto& team = registry.teams.emplace(entity);
-        team.team_id = TEAM_ID::NEUTRAL;
-
-        auto& tree = registry.static_objects.emplace(entity);
-        tree.type = STATIC_OBJECT_TYPE::ROCK;
-
-        // Use circle collider for tree
-        registry.collision_bounds.emplace(entity,
-            CollisionBounds::create_circle(Common::max_of(motion.scale) / 2));
-
-        return entity;
+        return spawn_batch(registry, rock_prefab(), { position }).front();
     }
 
     inline Entity create_bonfire(Registry& registry, glm::vec2 position) {
@@ -440,6 +471,7 @@ namespace EntityFactory {
         motion.angle = angle;
         motion.velocity = aim * weapon.proj_speed;
         motion.scale = glm::vec2(1.0f, 1.0f);  // Projectile size
+        registry.continuous_collisions.emplace(entity).start = motion.position;
 
         auto& projectile = registry.projectiles.emplace(entity);
         projectile.damage = weapon.damage;
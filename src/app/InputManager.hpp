@@ -1,6 +1,7 @@
 #pragma once
 
 #include <GLFW/glfw3.h>
+#include <fstream>
 #include <utils/Transform.hpp>
 #include <systems/GameplaySystem.hpp>
 #include <systems/InteractionSystem.hpp>
@@ -10,6 +11,7 @@
 #include "ecs/Registry.hpp"
 #include "globals/Globals.h"
 #include "utils/Common.hpp"
+#include "utils/Profiler.hpp"
 #include "systems/SaveLoadSystem.hpp"
 
 namespace InputManager {
@@ -17,6 +19,32 @@ namespace InputManager {
         Registry& registry = MapManager::get_instance().get_active_registry();
         Motion& player_motion = registry.motions.get(registry.player);
 
+        // Profiler and memory report keys work in every game state
+        if (action == GLFW_PRESS && key == GLFW_KEY_F3) {
+            Globals::show_profiler = !Globals::show_profiler;
+        }
+        if (action == GLFW_PRESS && key == GLFW_KEY_F4) {
+            std::string path = "profile_" + std::to_string(std::time(nullptr)) + ".json";
+            if (Profiler::write_chrome_trace(path)) {
+                std::cout << "Profiler trace written to " << path << std::endl;
+            } else {
+                std::cout << "Failed to write profiler trace" << std::endl;
+            }
+        }
+        if (action == GLFW_PRESS && key == GLFW_KEY_F8) {
+            Globals::show_memory = !Globals::show_memory;
+        }
+        if (action == GLFW_PRESS && key == GLFW_KEY_F9) {
+            std::string path = "memory_" + std::to_string(std::time(nullptr)) + ".csv";
+            std::ofstream file(path);
+            registry.write_memory_csv(file);
+            if (file) {
+                std::cout << "Memory report written to " << path << std::endl;
+            } else {
+                std::cout << "Failed to write memory report" << std::endl;
+            }
+        }
+
         if (Globals::is_getting_up) return;
 
         if (action == GLFW_PRESS && key == GLFW_KEY_F) {
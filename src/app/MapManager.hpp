@@ -38,8 +38,7 @@ public:
 
             // EntityFactory::create_test_boss(registry,glm::vec2(30.0f, 0.0f)); // example of a boss being created
 
-            saved_world_registry = std::make_unique<Registry>();
-            *saved_world_registry = *open_world_registry;
+            save_checkpoint();
 
             set_theme("OpenWorld");
         }
@@ -58,6 +57,17 @@ public:
         active_registry = open_world_registry.get();
     }
 
+    // Snapshots the open world for restart_maps. The snapshot shares the component pages with the open world
+    // (see PagedVector), so this is cheap enough to call at any bonfire.
+    void save_checkpoint() {
+        assert(open_world_registry && "save_checkpoint needs an open world");
+        if (!saved_world_registry) {
+            saved_world_registry = std::make_unique<Registry>();
+        }
+        *saved_world_registry = *open_world_registry;
+        saved_entity_pool = Entity::save_pool();
+    }
+
     // Called on respawns (ie. player death)
     void restart_maps() {
         assert(saved_world_registry && "saved_world_registry was not initialized but respawn is triggered.");
@@ -65,7 +75,10 @@ public:
         dungeon_registry.reset();
         open_world_registry.reset();
         open_world_registry = std::make_unique<Registry>();
+        // Shares the pages with the snapshot, only what the next frames write gets copied
         *open_world_registry = *saved_world_registry;
+        // Every entity created or destroyed since the save is gone with the registries, so the ids are too
+        Entity::restore_pool(saved_entity_pool);
         active_registry = open_world_registry.get();
         set_theme("OpenWorld");
         Globals::restart_renderer = true;
@@ -151,7 +164,13 @@ private:
         } else if (dungeon_difficulty == 1) {
             map_size = 500;
         }
+        // Dungeons of one difficulty come out about the same size, so the last one sizes the containers of the next
+        auto counts = dungeon_component_counts.find(dungeon_difficulty);
+        if (counts != dungeon_component_counts.end()) {
+            dungeon_registry->reserve(counts->second);
+        }
         ProceduralGenerationSystem::generate_dungeon(*dungeon_registry, map_size, map_size, dungeon_registry->motions.get(dungeon_registry->player), dungeon_difficulty);
+        dungeon_component_counts[dungeon_difficulty] = dungeon_registry->component_counts();
         // dungeon_registry->projectile_models = open_world_registry->projectile_models;
         set_theme("Dungeon");
         Globals::restart_renderer = true;
@@ -167,7 +186,10 @@ private:
         Motion player_motion_copy = open_world_registry->motions.get(open_world_registry->player);
         move_player_comps(*dungeon_registry, *open_world_registry);
         open_world_registry->motions.get(open_world_registry->player) = player_motion_copy;
+        release_dungeon_entities();
         dungeon_registry.reset();
+        // Gives back what the open world's containers grew to before the trip, e.g. for projectiles
+        open_world_registry->shrink_to_fit();
         set_theme("OpenWorld");
         Globals::restart_renderer = true;
     }
@@ -205,6 +227,17 @@ private:
         to.estus = from.estus;
     }
 
+    // Frees the ids of everything that only existed in the dungeon. The player's components must already be moved back.
+    void release_dungeon_entities() {
+        dungeon_registry->for_each_container([&](auto& container) {
+            for (Entity e : container.entities) {
+                if (!open_world_registry->valid(e)) {
+                    Entity::destroy(e);
+                }
+            }
+        });
+    }
+
     void move_player_weapon(Registry& from, Registry& to, Entity weapon) {
         to.remove_all_components_of(weapon);
 
@@ -223,5 +256,7 @@ private:
     // std::unique_ptr<Registry> spire_two_registry;     // Spire2 registry for future use
     // std::unique_ptr<Registry> spire_three_registry;   // Spire3 registry for future use
     std::unique_ptr<Registry> saved_world_registry;   // Instance of last saved checkpoint (only open_world has save ability)
+    Entity::Pool saved_entity_pool;                   // Entity ids in use when saved_world_registry was saved
     Registry* active_registry = nullptr;              // Points to the currently active registry
+    std::unordered_map<int, ComponentCounts> dungeon_component_counts; // Component counts of the last generated dungeon per difficulty
 };
@@ -11,6 +11,8 @@
 #include "systems/AudioSystem.hpp"
 
 #include "systems/AISystem.hpp"
+#include "systems/SpatialSortSystem.hpp"
+#include "utils/FrameArena.hpp"
 
 #include <components/RenderComponents.hpp> // For Motion component
 #include <app/GenerateRandomTrees.hpp>
@@ -21,7 +23,10 @@
 # include "MapManager.hpp"
 
 World::World()
-    : m_audioSystem(AudioSystem::get_instance()) {}
+    : m_audioSystem(AudioSystem::get_instance()),
+      m_scheduler([]() -> Registry& { return MapManager::get_instance().get_active_registry(); }) {
+    register_systems();
+}
 World::~World() = default;
 
 void World::restart_game() {
@@ -138,36 +143,66 @@ void World::demo_init() {
 
 
 void World::step(float elapsed_ms) {
-    // TODO: Update the game world
-    // 1. Update physics
-    // {
-    // Timer timer;
-    GridMapSystem::update_grid_map();
-    // }
-
-    PhysicsSystem::step(elapsed_ms);
-    PhysicsSystem::update_interpolations();
-
-    CollisionSystem::check_collisions();
-    CollisionSystem::handle_collisions();
-
-    m_audioSystem.handle_audio_per_frame();
+    PROFILE_ZONE("World::step");
+    // No job runs between frames, so every thread's scratch memory of the last frame can be handed out again
+    FrameArena::reset_all();
+    // Changes made during this frame are newer than anything systems looked at last frame
+    MapManager::get_instance().get_active_registry().advance_change_version();
+    m_scheduler.run(elapsed_ms);
+}
 
-    AISystem::AI_step();
+void World::register_systems() {
+    using R = SystemResource;
+    auto flush_commands = [](float) { MapManager::get_instance().get_active_registry().flush_commands(); };
+
+    // Systems are added in the order the frame needs them. Systems that conflict run in this order, the others of
+    // a stage run in parallel. Anything that may emplace, remove or destroy right away writes R::Structure, and
+    // everything that is hard to list (collisions, AI, map switches) is SystemAccess::all().
+    m_scheduler.add("update_grid_map", SystemAccess().read<NearPlayer, Motion, CollisionBounds>().write(R::GridMap),
+        [](float) { GridMapSystem::update_grid_map(); });
+    m_scheduler.add("physics_step", SystemAccess().read<NearPlayer, DeathCooldown, InDodge, Enemy, Attacker>().write<Motion, ContinuousCollision>(),
+        [](float elapsed_ms) { PhysicsSystem::step(elapsed_ms); });
+    m_scheduler.add("update_interpolations", SystemAccess().write<InDodge, Motion>().write(R::Structure),
+        [](float) { PhysicsSystem::update_interpolations(); });
+
+    m_scheduler.add("check_collisions", SystemAccess::all(), [](float) { CollisionSystem::check_collisions(); });
+    m_scheduler.add("handle_collisions", SystemAccess::all(), [](float) { CollisionSystem::handle_collisions(); });
+    // Sync point: projectiles destroyed by collisions are removed before the AI sees them
+    m_scheduler.add("flush_commands", SystemAccess::all(), flush_commands);
+
+    m_scheduler.add("AI_step", SystemAccess::all(), [](float) { AISystem::AI_step(); });
     // AISystem::boss_AI_step(elapsed_ms); // conditional this for with in_boss_fight flag
 
-    InputManager::handle_inputs_per_frame();
-
-    InteractionSystem::update_near_interactable();
-
-    GameplaySystem::update_cooldowns(elapsed_ms);
-    GameplaySystem::update_regen_stats(elapsed_ms);
-    GameplaySystem::update_projectile_range(elapsed_ms);
-    GameplaySystem::update_near_player_camera();
-
-    enforce_boundaries(MapManager::get_instance().get_active_registry().player);
-
-    MapManager::get_instance().switch_map();
+    // Audio only follows the input state, so it plays alongside the input handling
+    m_scheduler.add("handle_audio", SystemAccess().read(R::InputState).write(R::Audio),
+        [this](float) { m_audioSystem.handle_audio_per_frame(); });
+    m_scheduler.add("handle_inputs", SystemAccess().read<LocomotionStats, StaggerCooldown>().write<Motion, Attacker>().read(R::InputState).read(R::Interaction),
+        [](float) { InputManager::handle_inputs_per_frame(); });
+
+    // These three only read the player's new motion, so they share a stage. Regen and projectile range used to run
+    // after update_cooldowns, which is the same frame result since its removals are deferred to the next flush.
+    m_scheduler.add("update_near_interactable", SystemAccess().read<NearPlayer, Interactable, Motion, InRest>().write(R::Interaction),
+        [](float) { InteractionSystem::update_near_interactable(); });
+    m_scheduler.add("update_regen_stats", SystemAccess().read<NearPlayer, EnergyNoRegenCooldown>().write<LocomotionStats>(),
+        [](float elapsed_ms) { GameplaySystem::update_regen_stats(elapsed_ms); });
+    m_scheduler.add("update_projectile_range", SystemAccess().read<Motion>().write<Projectile>().write(R::Commands),
+        [](float elapsed_ms) { GameplaySystem::update_projectile_range(elapsed_ms); });
+
+    // May restart the game when the player died
+    m_scheduler.add("update_cooldowns", SystemAccess::all(),
+        [](float elapsed_ms) { GameplaySystem::update_cooldowns(elapsed_ms); });
+    // Sync point: expired cooldowns, dead entities and newly fired projectiles
+    m_scheduler.add("flush_commands", SystemAccess::all(), flush_commands);
+    // Moves components in memory, so it must not run next to any other system
+    m_scheduler.add("sort_by_position", SystemAccess::all(),
+        [](float elapsed_ms) { SpatialSortSystem::step(elapsed_ms); });
+    m_scheduler.add("update_near_player_camera", SystemAccess().read<Motion>().write<NearPlayer, NearCamera>().write(R::Structure),
+        [](float) { GameplaySystem::update_near_player_camera(); });
+
+    m_scheduler.add("enforce_boundaries", SystemAccess().write<Motion>(),
+        [this](float) { enforce_boundaries(MapManager::get_instance().get_active_registry().player); });
+
+    m_scheduler.add("switch_map", SystemAccess::all(), [](float) { MapManager::get_instance().switch_map(); });
 }
 
 void World::enforce_boundaries(Entity entity) {
@@ -175,6 +210,7 @@ void World::enforce_boundaries(Entity entity) {
 
     if (registry.motions.has(entity)) {
         Motion& motion = registry.motions.get(entity);
+        const glm::vec2 position = motion.position;
         
         // Adjust these values based on the actual visible boundaries of your map
         const float LEFT_BOUND = -MAP_WIDTH / 2.0f;  // Assuming the map is centered
@@ -195,5 +231,6 @@ void World::enforce_boundaries(Entity entity) {
         } else if (motion.position.y > TOP_BOUND) {
             motion.position.y = TOP_BOUND;
         }
+        if (motion.position != position) registry.motions.mark_changed(entity);
     }
 }
@@ -2,6 +2,7 @@
 
 #include <ecs/Registry.hpp>
 #include <ecs/Entity.hpp>
+#include <ecs/SystemScheduler.hpp>
 #include <vector>
 #include <globals/Globals.h>
 #include <utils/Common.hpp>
@@ -21,6 +22,8 @@ private:
 	void handle_projectile_collision(const Entity& projectile, const Entity& target);
 	void handle_entity_collision(const Entity& entity1, const Entity& entity2);
 	void enforce_boundaries(Entity entity); // Method to enforce boundaries
+	void register_systems(); // Declares the systems of step() and what each of them reads and writes
 
 	AudioSystem& m_audioSystem;
+	SystemScheduler m_scheduler;
 };
@@ -58,4 +58,13 @@ struct BossAI {
     unsigned int attack_index;          // index of the next attack within current combo
     float attack_delay_counter;         // delay counter before next attack
     float attack_range;                 // distance from player that the boss starts a combo
-};
\ No newline at end of file
+};
+
+// The combo tables, see Registry::memory_report
+inline size_t owned_heap_bytes(const BossAI& boss) {
+    size_t bytes = boss.combos.capacity() * sizeof(AttackCombo) + boss.q.capacity() * sizeof(float) + boss.k.capacity() * sizeof(unsigned int);
+    for (const AttackCombo& combo : boss.combos) {
+        bytes += combo.attacks.capacity() * sizeof(BOSS_ATTACK_TYPE) + combo.delays.capacity() * sizeof(float);
+    }
+    return bytes;
+}
\ No newline at end of file
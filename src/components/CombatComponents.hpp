@@ -48,7 +48,7 @@ struct Weapon
 struct Attacker
 {
     glm::vec2 aim = {0, 0}; // it is normalized
-    Entity weapon;
+    Entity weapon = Entity::null();
 };
 
 struct AttackCooldown
@@ -90,6 +90,11 @@ struct Projectile
     ENCHANTMENT enchantment; // Added for future milestones
 };
 
+// The hit list grows with every entity a melee swing passes through, see Registry::memory_report
+inline size_t owned_heap_bytes(const Projectile& projectile) {
+    return projectile.hit_locos.capacity() * sizeof(unsigned int);
+}
+
 enum class TEAM_ID
 {
 	FRIENDLY = 0,
@@ -92,7 +92,7 @@ const int interactable_type_count = (int)INTERACTABLE_TYPE::INTERACTABLE_TYPE_CO
 struct Interactable
 {
     INTERACTABLE_TYPE type;
-    Entity entity;
+    Entity entity = Entity::null();
     float range;
     int dungeon_difficulty;
 };
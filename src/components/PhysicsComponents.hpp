@@ -5,6 +5,9 @@
 #include <glm/common.hpp>     // for min, max
 #include "ecs/Entity.hpp"
 #include <vector>
+#include <deque>
+#include <unordered_map>
+#include <functional>
 #include <limits>
 #include <cmath>
 
@@ -19,6 +22,14 @@ struct Motion
 	float drag = 0;
 };
 
+// Marks a fast mover, such as a projectile, for swept collision tests. PhysicsSystem::step records the position
+// before it moves the entity, and CollisionSystem tests the whole path from there to the new position, so the entity
+// cannot pass through a thin wall between two steps, however long the step.
+struct ContinuousCollision
+{
+	glm::vec2 start = {0, 0};
+};
+
 struct MoveWith
 {
 	unsigned int following_entity_id;
@@ -68,62 +79,106 @@ struct WallCollider {
     std::vector<LineSegment> edges; // For precise collision
 };
 
+// Owns every wall and mesh shape that a CollisionBounds points to. Shapes are interned: a shape that is
+// equal to one already in the library is not stored again, so all walls of one size and angle, and all
+// projectiles of one model, share a single hull. Shapes are immutable and live until the program exits,
+// which makes copying a CollisionBounds a pointer copy. The deques keep the shapes in large blocks and
+// never move them, so the pointers stay valid.
+class ColliderShapeLibrary {
+public:
+    static ColliderShapeLibrary& get_instance() {
+        static ColliderShapeLibrary instance;
+        return instance;
+    }
+
+    const WallCollider* intern(const WallCollider& wall) {
+        size_t hash = hash_vec2(0, wall.aabb.min);
+        hash = hash_vec2(hash, wall.aabb.max);
+        for (const LineSegment& edge : wall.edges) {
+            hash = hash_vec2(hash, edge.start);
+            hash = hash_vec2(hash, edge.end);
+        }
+
+        auto range = wall_lookup.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (equal(*it->second, wall)) return it->second;
+        }
+        walls.push_back(wall);
+        wall_lookup.emplace(hash, &walls.back());
+        return &walls.back();
+    }
+
+    const MeshCollider* intern(const MeshCollider& mesh) {
+        size_t hash = hash_float(0, mesh.bound_radius);
+        for (const glm::vec2& vertex : mesh.vertices) {
+            hash = hash_vec2(hash, vertex);
+        }
+
+        auto range = mesh_lookup.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (equal(*it->second, mesh)) return it->second;
+        }
+        meshes.push_back(mesh);
+        mesh_lookup.emplace(hash, &meshes.back());
+        return &meshes.back();
+    }
+
+    size_t wall_count() const { return walls.size(); }
+    size_t mesh_count() const { return meshes.size(); }
+
+    // Shapes, their edge and vertex lists and the lookup tables. Map nodes are counted as the entry plus two pointers.
+    size_t memory_bytes() const {
+        size_t bytes = walls.size() * sizeof(WallCollider) + meshes.size() * sizeof(MeshCollider);
+        for (const WallCollider& wall : walls) bytes += wall.edges.capacity() * sizeof(LineSegment);
+        for (const MeshCollider& mesh : meshes) bytes += mesh.vertices.capacity() * sizeof(glm::vec2);
+        bytes += wall_lookup.bucket_count() * sizeof(void*) + wall_lookup.size() * (sizeof(std::pair<size_t, const WallCollider*>) + 2 * sizeof(void*));
+        bytes += mesh_lookup.bucket_count() * sizeof(void*) + mesh_lookup.size() * (sizeof(std::pair<size_t, const MeshCollider*>) + 2 * sizeof(void*));
+        return bytes;
+    }
+
+private:
+    std::deque<WallCollider> walls;
+    std::deque<MeshCollider> meshes;
+    std::unordered_multimap<size_t, const WallCollider*> wall_lookup;
+    std::unordered_multimap<size_t, const MeshCollider*> mesh_lookup;
+
+    ColliderShapeLibrary() {}
+
+    static size_t hash_float(size_t seed, float value) {
+        return seed ^ (std::hash<float>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+    }
+
+    static size_t hash_vec2(size_t seed, const glm::vec2& value) {
+        return hash_float(hash_float(seed, value.x), value.y);
+    }
+
+    static bool equal(const WallCollider& a, const WallCollider& b) {
+        if (a.aabb.min != b.aabb.min || a.aabb.max != b.aabb.max || a.edges.size() != b.edges.size()) return false;
+        for (size_t i = 0; i < a.edges.size(); i++) {
+            if (a.edges[i].start != b.edges[i].start || a.edges[i].end != b.edges[i].end || a.edges[i].normal != b.edges[i].normal) return false;
+        }
+        return true;
+    }
+
+    static bool equal(const MeshCollider& a, const MeshCollider& b) {
+        return a.bound_radius == b.bound_radius && a.vertices == b.vertices;
+    }
+};
+
 struct CollisionBounds {
     ColliderType type;
     union {
         CircleCollider circle;
         AABBCollider aabb;
-        WallCollider* wall;
-        MeshCollider* mesh;
+        const WallCollider* wall; // shared, see ColliderShapeLibrary
+        const MeshCollider* mesh; // shared, see ColliderShapeLibrary
     };
 
     // Default constructor
     CollisionBounds() : type(ColliderType::Circle), circle{0} {}
 
-    // Copy constructor
+    // Copy constructor, wall and mesh shapes are shared so no case allocates
     CollisionBounds(const CollisionBounds& other) : type(other.type) {
-        switch (type) {
-            case ColliderType::Circle:
-                circle = other.circle;
-                break;
-            case ColliderType::AABB:
-                aabb = other.aabb;
-                break;
-            case ColliderType::Wall:
-                wall = new WallCollider(*other.wall);
-                break;
-            case ColliderType::Mesh:
-                mesh = new MeshCollider(*other.mesh);
-                break;
-        }
-    }
-
-    // Assignment operator
-    CollisionBounds& operator=(const CollisionBounds& other) {
-        if (this != &other) {
-            cleanup();
-            
-            type = other.type;
-            switch (type) {
-                case ColliderType::Circle:
-                    circle = other.circle;
-                    break;
-                case ColliderType::AABB:
-                    aabb = other.aabb;
-                    break;
-                case ColliderType::Wall:
-                    wall = new WallCollider(*other.wall);
-                    break;
-                case ColliderType::Mesh:
-                    mesh = new MeshCollider(*other.mesh);
-                    break;
-            }
-        }
-        return *this;
-    }
-
-    // Move constructor
-    CollisionBounds(CollisionBounds&& other) noexcept : type(other.type) {
         switch (type) {
             case ColliderType::Circle:
                 circle = other.circle;
@@ -133,19 +188,16 @@ struct CollisionBounds {
                 break;
             case ColliderType::Wall:
                 wall = other.wall;
-                other.wall = nullptr;
                 break;
             case ColliderType::Mesh:
                 mesh = other.mesh;
-                other.mesh = nullptr;
                 break;
         }
     }
 
-    // Move assignment operator
-    CollisionBounds& operator=(CollisionBounds&& other) noexcept {
+    // Assignment operator
+    CollisionBounds& operator=(const CollisionBounds& other) {
         if (this != &other) {
-            cleanup();
             type = other.type;
             switch (type) {
                 case ColliderType::Circle:
@@ -156,33 +208,15 @@ struct CollisionBounds {
                     break;
                 case ColliderType::Wall:
                     wall = other.wall;
-                    other.wall = nullptr;
                     break;
                 case ColliderType::Mesh:
                     mesh = other.mesh;
-                    other.mesh = nullptr;
                     break;
             }
         }
         return *this;
     }
 
-    // Helper function for cleanup
-    void cleanup() {
-        if (type == ColliderType::Wall && wall != nullptr) {
-            delete wall;
-            wall = nullptr;
-        }
-        if (type == ColliderType::Mesh && mesh != nullptr) {
-            delete mesh;
-            mesh = nullptr;
-        }
-    }
-
-    ~CollisionBounds() {
-        cleanup();
-    }
-
     // Factory functions
     static CollisionBounds create_circle(float radius) {
         CollisionBounds bounds;
@@ -200,9 +234,7 @@ struct CollisionBounds {
     }
     
     static CollisionBounds create_wall(const glm::vec2& size, float angle) {
-        CollisionBounds bounds;
-        bounds.type = ColliderType::Wall;
-        bounds.wall = new WallCollider;
+        WallCollider shape;
         
         // Create rotated AABB
         glm::vec2 half_size = size/2.0f;
@@ -237,36 +269,34 @@ struct CollisionBounds {
             max_bound.y = std::fmax(max_bound.y, rotated_corners[i].y);
         }
         
-        bounds.wall->aabb.min = min_bound;
-        bounds.wall->aabb.max = max_bound;
+        shape.aabb.min = min_bound;
+        shape.aabb.max = max_bound;
         
         // Create edges with proper normals
-        bounds.wall->edges.clear();
+        shape.edges.clear();
         for (int i = 0; i < 4; i++) {
             int next = (i + 1) % 4;
             glm::vec2 edge_vec = rotated_corners[next] - rotated_corners[i];
             glm::vec2 normal(-edge_vec.y, edge_vec.x);
             normal = glm::normalize(normal);
             
-            bounds.wall->edges.push_back({
+            shape.edges.push_back({
                 rotated_corners[i],
                 rotated_corners[next],
                 normal
             });
         }
         
+        CollisionBounds bounds;
+        bounds.type = ColliderType::Wall;
+        bounds.wall = ColliderShapeLibrary::get_instance().intern(shape);
         return bounds;
     }
     
     static CollisionBounds create_mesh(const std::vector<glm::vec2>& verts, float bound_radius) {
         CollisionBounds bounds;
         bounds.type = ColliderType::Mesh;
-        bounds.mesh = new MeshCollider{verts, bound_radius};
+        bounds.mesh = ColliderShapeLibrary::get_instance().intern(MeshCollider{verts, bound_radius});
         return bounds;
     }
-};
-
-struct Collision {
-    Entity other;
-    Collision(Entity &other) { this->other = other; }
 };
\ No newline at end of file
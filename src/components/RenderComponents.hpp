@@ -7,6 +7,13 @@ struct TextureName {
     std::string name;
 };
 
+// Short names live inside the string object itself and own nothing, see Registry::memory_report
+inline size_t owned_heap_bytes(const TextureName& texture) {
+    const char* data = texture.name.data();
+    const bool inline_buffer = data >= reinterpret_cast<const char*>(&texture.name) && data < reinterpret_cast<const char*>(&texture.name + 1);
+    return inline_buffer ? 0 : texture.name.capacity() + 1;
+}
+
 struct ProjectileModels {
     StaticModel* arrow_model = nullptr;
     StaticModel* melee_model = nullptr;
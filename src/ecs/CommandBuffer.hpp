@@ -0,0 +1,66 @@
+#pragma once
+
+#include <ecs/Entity.hpp>
+#include <ecs/ComponentMask.hpp>
+
+#include <functional>
+#include <vector>
+
+class Registry;
+
+// Structural changes recorded by systems while they iterate the registry. Nothing happens until the registry
+// plays the buffer back with Registry::flush_commands() at one of the sync points in World::step.
+// The vectors are cleared but not freed on playback, so recording does not allocate in steady state.
+class CommandBuffer {
+public:
+	// Removes the T component of e
+	template <typename T>
+	void remove(Entity e) {
+		removals_by_component[ComponentIndex<T>::value].push_back(e);
+	}
+
+	// Removes all components of e and frees its id, see Registry::destroy
+	void destroy(Entity e) {
+		destroyed.push_back(e);
+		const unsigned int index = e.get_index();
+		if (index >= pending_destroy.size()) pending_destroy.resize(index + 1, false);
+		pending_destroy[index] = true;
+	}
+
+	// Runs func on the registry after the removals, e.g. to create an entity with EntityFactory.
+	// Capture by value, references into containers may be gone by then.
+	void spawn(std::function<void(Registry&)> func) {
+		spawns.push_back(std::move(func));
+	}
+
+	// True if e is recorded for destruction. Lets systems skip entities that are dead but not yet removed.
+	// One bit test per entity index; a stale handle to a reused index may also answer true, callers check valid() too.
+	bool is_destroy_pending(Entity e) const {
+		const unsigned int index = e.get_index();
+		return index < pending_destroy.size() && pending_destroy[index];
+	}
+
+	bool empty() const {
+		if (!destroyed.empty() || !spawns.empty()) return false;
+		for (const auto& removals : removals_by_component) {
+			if (!removals.empty()) return false;
+		}
+		return true;
+	}
+
+	void clear() {
+		for (auto& removals : removals_by_component) removals.clear();
+		for (Entity e : destroyed) pending_destroy[e.get_index()] = false;
+		destroyed.clear();
+		spawns.clear();
+	}
+
+private:
+	friend class Registry;
+
+	// One list per container, so playback can remove from each container in one sorted pass
+	std::vector<Entity> removals_by_component[sizeof(ComponentMask) * 8];
+	std::vector<Entity> destroyed;
+	std::vector<bool> pending_destroy; // indexed by Entity::get_index(), set for the entities in destroyed
+	std::vector<std::function<void(Registry&)>> spawns;
+};
@@ -4,35 +4,96 @@
 #include <ostream>
 #include <ecs/Entity.hpp>
 #include <ecs/IComponentContainer.hpp>
+#include <ecs/PagedSparseArray.hpp>
+#include <ecs/PagedVector.hpp>
+#include <ecs/ComponentMask.hpp>
 
+#include <algorithm>
+#include <climits>
+#include <numeric>
 #include <vector>
-#include <unordered_map>
 
 template <typename Component> // A component can be any class
 class ComponentContainer : public IComponentContainer {
 private:
-	// The hash map from Entity -> array index.
-	std::unordered_map<unsigned int, unsigned int> map_entity_componentID; // the entity is cast to uint to be hashable.
+	static constexpr unsigned int INVALID_INDEX = UINT_MAX;
+
+	// The sparse array from Entity index -> array index.
+	PagedSparseArray<unsigned int, INVALID_INDEX> map_entity_componentID;
 	bool registered = false;
+
+	// The signatures of the owning Registry and the bit of this component type in them, see bind_signatures
+	EntitySignatures* signatures = nullptr;
+	ComponentMask signature_bit = 0;
+
+	// The change version of the owning Registry, see bind_signatures. Containers without a registry stay at version 1.
+	const ChangeVersion* current_version = nullptr;
+
+	// Every component counts as changed at this version or later, raised when the whole container is replaced
+	ChangeVersion changed_all_version = 0;
+
+	// The version of the last insert, removal, clear or replacement, i.e. the last change to which entities have one
+	ChangeVersion structure_version = 0;
+
+	// Scratch space of remove_batch, kept to avoid allocating on every call
+	std::vector<unsigned int> batch_indices;
+
+	void clear_signature_bits() {
+		if (!signatures) return;
+		for (Entity e : entities)
+			signatures->at(e.get_index()) &= ~signature_bit;
+	}
+
+	void set_signature_bits() {
+		if (!signatures) return;
+		for (Entity e : entities)
+			signatures->at(e.get_index()) |= signature_bit;
+	}
+
+	// Returns the array index of the entity with this id, or INVALID_INDEX. A stale id whose index was reused does not match.
+	unsigned int find(unsigned int entity_id) const {
+		const unsigned int cID = map_entity_componentID.get(entity_id & Entity::INDEX_MASK);
+		return (cID != INVALID_INDEX && entities[cID].get_id() == entity_id) ? cID : INVALID_INDEX;
+	}
 public:
-	// Container of all components of type 'Component'
-	std::vector<Component> components;
+	// Container of all components of type 'Component'. Its pages are shared with copies of this container until written.
+	PagedVector<Component> components;
 
 	// The corresponding entities
 	std::vector<Entity> entities;
 
+	// The change version of each component's last insert or mark_changed, parallel to components
+	PagedVector<ChangeVersion> versions;
+
 	// Constructor that registers the type
 	ComponentContainer() {
 	}
 
+	// Copies the components but not the signature binding, which stays with the owning Registry
+	ComponentContainer(const ComponentContainer& other)
+		: map_entity_componentID(other.map_entity_componentID),
+		  registered(other.registered),
+		  changed_all_version(other.changed_all_version),
+		  structure_version(other.structure_version),
+		  components(other.components),
+		  entities(other.entities),
+		  versions(other.versions) {
+	}
+
+	// Keeps bit component_index of the registry's entity signatures in sync with this container and stamps changes
+	// with the registry's change version. The binding belongs to the container and is not copied by operator=.
+	void bind_signatures(EntitySignatures* entity_signatures, unsigned int component_index, const ChangeVersion* change_version) {
+		signatures = entity_signatures;
+		signature_bit = ComponentMask(1) << component_index;
+		current_version = change_version;
+		set_signature_bits();
+	}
+
 	IComponentContainer& operator=(const IComponentContainer& other) override {
         if (this != &other) {
             const auto* derived = dynamic_cast<const ComponentContainer<Component>*>(&other);
             if (derived) {
-                map_entity_componentID = derived->map_entity_componentID;
-                registered = derived->registered;
-                components = derived->components;
-                entities = derived->entities;
+                *this = *derived;
             }
         }
         return *this;
@@ -40,26 +101,36 @@ public:
 
 	ComponentContainer& operator=(const ComponentContainer& other) {
 		if (this != &other) {
-			map_entity_componentID = other.map_entity_componentID;
-			registered = other.registered;
-			components = other.components;
-			entities = other.entities;
+			clear_signature_bits();
+			assign_data(other);
+			set_signature_bits();
 		}
 		return *this;
 	}
 
+	// Copies the components without updating the signatures, for a Registry that copies its signatures as a whole.
+	// Only the entity list is copied element-wise, the component and sparse array pages are shared until written.
+	void assign_data(const ComponentContainer& other) {
+		map_entity_componentID = other.map_entity_componentID;
+		registered = other.registered;
+		changed_all_version = other.changed_all_version;
+		structure_version = other.structure_version;
+		components = other.components;
+		entities = other.entities;
+		versions = other.versions;
+	}
+
 	// Inserting a component c associated to entity e
 	inline Component& insert(Entity e, Component c, bool check_for_duplicates = true) {
 		// Usually, every entity should only have one instance of each component type
-		// map_entity_componentID.count(e);
-		if (map_entity_componentID.size() > 0) {
-			assert(!(check_for_duplicates && has(e)) && "Entity already contained in ECS registry");
-		}
+		assert(!(check_for_duplicates && has(e)) && "Entity already contained in ECS registry");
 
-
-		map_entity_componentID[e] = (unsigned int)components.size();
+		map_entity_componentID.set(e.get_index(), (unsigned int)components.size());
+		if (signatures) signatures->at(e.get_index()) |= signature_bit;
 		components.push_back(std::move(c)); // the move enforces move instead of copy constructor
 		entities.push_back(e);
+		versions.push_back(change_version());
+		structure_version = change_version();
 		return components.back();
 	};
 
@@ -76,41 +147,119 @@ public:
 	// A wrapper to return the component of an entity
 	Component& get(Entity e) {
 		assert(has(e) && "Entity not contained in ECS registry");
-		return components[map_entity_componentID[e]];
+		return components[find(e)];
 	}
 
 	// A wrapper to return the component of an entity specified by id
 	Component& get(unsigned int entity_id) {
-		assert(map_entity_componentID.count(entity_id) > 0 && "Entity not contained in ECS registry");
-		return components[map_entity_componentID[entity_id]];
+		assert(find(entity_id) != INVALID_INDEX && "Entity not contained in ECS registry");
+		return components[find(entity_id)];
+	}
+
+	// Read-only access, does not copy a page that is shared with a snapshot
+	const Component& get(Entity e) const {
+		assert(find(e) != INVALID_INDEX && "Entity not contained in ECS registry");
+		return components[find(e)];
+	}
+
+	// Returns the component of an entity, or nullptr if it has none. Use this instead of has() followed by get()
+	Component* try_get(Entity e) {
+		const unsigned int cID = find(e);
+		return cID != INVALID_INDEX ? &components[cID] : nullptr;
+	}
+
+	const Component* try_get(Entity e) const {
+		const unsigned int cID = find(e);
+		return cID != INVALID_INDEX ? &components[cID] : nullptr;
 	}
 
 	// Check if entity has a component of type 'Component'
 	bool has(Entity entity) {
-		return map_entity_componentID.count(entity) > 0;
+		return find(entity) != INVALID_INDEX;
 	}
 
 	// Remove an component and pack the container to re-use the empty space
 	void remove(unsigned int entity_id) {
-		if (map_entity_componentID.count(entity_id) > 0)
+		const unsigned int cID = find(entity_id);
+		if (cID != INVALID_INDEX)
 		{
-			// Get the current position
-			int cID = map_entity_componentID[entity_id];
-
-			// Move the last element to position cID using the move operator
-			// Note, components[cID] = components.back() would trigger the copy instead of move operator
-			components[cID] = std::move(components.back());
-			entities[cID] = entities.back(); // the entity is only a single index, copy it.
-			map_entity_componentID[entities.back()] = cID;
-
-			// Erase the old component and free its memory
-			map_entity_componentID.erase(entity_id);
-			components.pop_back();
-			entities.pop_back();
-			// Note, one could mark the id for re-use
+			remove_at(cID);
 		}
 	};
 
+	// Remove the component at array index cID by moving the last one into its place
+	void remove_at(unsigned int cID) {
+		const unsigned int index = entities[cID].get_index();
+
+		// Move the last element to position cID using the move operator
+		// Note, components[cID] = components.back() would trigger the copy instead of move operator
+		components[cID] = std::move(components.back());
+		entities[cID] = entities.back(); // the entity is only a single index, copy it.
+		versions[cID] = versions.back();
+		map_entity_componentID.set(entities.back().get_index(), cID);
+
+		// Erase the old component and free its memory
+		map_entity_componentID.reset(index);
+		if (signatures) signatures->at(index) &= ~signature_bit;
+		components.pop_back();
+		entities.pop_back();
+		versions.pop_back();
+		structure_version = change_version();
+	}
+
+	// Remove the components of several entities. The array indices are sorted from the back, so each swap-and-pop
+	// only moves an element that stays, and the indices looked up at the start remain valid throughout.
+	void remove_batch(std::vector<Entity>& batch) override {
+		batch_indices.clear();
+		for (Entity e : batch) {
+			const unsigned int cID = find(e);
+			if (cID != INVALID_INDEX) batch_indices.push_back(cID);
+		}
+		std::sort(batch_indices.begin(), batch_indices.end(), std::greater<unsigned int>());
+		batch_indices.erase(std::unique(batch_indices.begin(), batch_indices.end()), batch_indices.end());
+		for (unsigned int cID : batch_indices) {
+			remove_at(cID);
+		}
+	}
+
+	// The version new changes are stamped with
+	ChangeVersion change_version() const {
+		return current_version ? *current_version : 1;
+	}
+
+	// Records that the component of e was written. get() does not do this by itself, since most callers only read,
+	// so code that moves or edits a component other systems cache has to call this or use patch(). Ignores entities without one.
+	void mark_changed(Entity e) {
+		const unsigned int cID = find(e);
+		if (cID != INVALID_INDEX) versions[cID] = change_version();
+	}
+
+	// get() for a write, marks the component as changed
+	Component& patch(Entity e) {
+		assert(has(e) && "Entity not contained in ECS registry");
+		const unsigned int cID = find(e);
+		versions[cID] = change_version();
+		return components[cID];
+	}
+
+	// True if the component of e was inserted or marked at the given version or later. False if e has none.
+	bool changed_since(Entity e, ChangeVersion version) const {
+		const unsigned int cID = find(e);
+		return cID != INVALID_INDEX && std::max(versions[cID], changed_all_version) >= version;
+	}
+
+	// Marks every component as changed, for when the whole container was replaced (see Registry::operator=)
+	void mark_all_changed() {
+		changed_all_version = change_version();
+		structure_version = changed_all_version;
+	}
+
+	// The version at which an entity last gained or lost this component, or the container was replaced. O(1), for
+	// caches that only depend on which entities have the component, such as the static colliders of CollisionSystem.
+	ChangeVersion last_structural_change() const {
+		return structure_version;
+	}
+
 	// Remove an component and pack the container to re-use the empty space
 	void remove(Entity e) {
 		remove((unsigned int)e);
@@ -118,9 +267,21 @@ public:
 
 	// Remove all components of type 'Component'
 	void clear() {
-		map_entity_componentID.clear();
+		if (!entities.empty()) structure_version = change_version();
+		clear_signature_bits();
+		// Only reset the used slots so the allocated pages are kept for the next frame
+		for (Entity e : entities)
+			map_entity_componentID.reset(e.get_index());
 		components.clear();
 		entities.clear();
+		versions.clear();
+	}
+
+	// Copies the component pages still shared with a snapshot. After this get() never writes container state,
+	// so several threads may call it at once, see SystemScheduler.
+	void unshare() override {
+		components.unshare_all();
+		versions.unshare_all();
 	}
 
 	// Report the number of components of type 'Component'
@@ -128,17 +289,91 @@ public:
 		return components.size();
 	}
 
+	// Makes room for n components in total, see Prefab and Registry::reserve
+	void reserve(size_t n) override {
+		components.reserve(n);
+		versions.reserve(n);
+		entities.reserve(n);
+	}
+
+	// Frees the pages and capacity behind the last component and the empty pages of the sparse map
+	void shrink_to_fit() override {
+		components.shrink_to_fit();
+		versions.shrink_to_fit();
+		entities.shrink_to_fit();
+		std::vector<unsigned int>().swap(batch_indices);
+		map_entity_componentID.shrink_to_fit();
+	}
+
+	// Read only, so pages shared with a snapshot are not copied. Visits every component to add up owned_heap_bytes.
+	MemoryUsage memory_usage() const override {
+		MemoryUsage usage;
+		usage.count = components.size();
+		usage.component_bytes = components.size() * sizeof(Component);
+		usage.component_reserved = components.allocated_bytes();
+		usage.shared_bytes = components.shared_page_count() * PagedVector<Component>::PAGE_SIZE * sizeof(Component);
+		usage.entity_bytes = entities.size() * sizeof(Entity) + versions.size() * sizeof(ChangeVersion);
+		usage.entity_reserved = entities.capacity() * sizeof(Entity) + versions.allocated_bytes() + batch_indices.capacity() * sizeof(unsigned int);
+		usage.index_bytes = map_entity_componentID.allocated_bytes();
+		for (size_t i = 0; i < components.size(); i++) {
+			usage.owned_bytes += owned_heap_bytes(components[i]);
+		}
+		return usage;
+	}
+
+	// The array index of the entity's component, or UINT_MAX if it has none. Only stable until the next remove or sort.
+	unsigned int index_of(Entity e) const {
+		return find(e);
+	}
+
+	// Rearranges the container so that array index i holds what was at array index order[i]. Works in place:
+	// every element is moved once along the cycles of the permutation, elements already in place are not touched
+	// (and their pages stay shared with snapshots), and only moved entities are updated in the sparse array.
+	// order has to be a permutation of 0..size()-1 and is left as the identity.
+	void apply_order(std::vector<unsigned int>& order) {
+		assert(order.size() == components.size() && "apply_order needs one index per component");
+		for (unsigned int i = 0; i < order.size(); i++) {
+			if (order[i] == i) continue;
+			Component component = std::move(components[i]);
+			const Entity entity = entities[i];
+			const ChangeVersion version = versions[i];
+			unsigned int j = i;
+			while (order[j] != i) {
+				const unsigned int next = order[j];
+				components[j] = std::move(components[next]);
+				entities[j] = entities[next];
+				versions[j] = versions[next];
+				map_entity_componentID.set(entities[j].get_index(), j);
+				order[j] = j;
+				j = next;
+			}
+			components[j] = std::move(component);
+			entities[j] = entity;
+			versions[j] = version;
+			map_entity_componentID.set(entity.get_index(), j);
+			order[j] = j;
+		}
+	}
+
 	// Sort the components and associated entity assignment structures by the comparisonFunction, see std::sort
 	template <class Compare>
 	void sort(Compare comparisonFunction) {
-		// First sort the entity list as desired
-		std::sort(entities.begin(), entities.end(), comparisonFunction);
-		// Now re-arrange the components (Note, creates a new vector, which may be slow! Not sure if in-place could be faster: https://stackoverflow.com/questions/63703637/how-to-efficiently-permute-an-array-in-place-using-stdswap)
-		std::vector<Component> components_new; components_new.reserve(components.size());
-		std::transform(entities.begin(), entities.end(), std::back_inserter(components_new), [&](Entity e) { return std::move(get(e)); }); // note, the get still uses the old hash map (on purpose!)
-		components = std::move(components_new); // note, we use move operations to not create unneccesary copies of objects, but memory is still allocated for the new vector
-		// Fill the new hashmap
-		for (unsigned int i = 0; i < entities.size(); i++)
-			map_entity_componentID[entities[i]] = i;
+		std::vector<unsigned int> order(entities.size());
+		std::iota(order.begin(), order.end(), 0u);
+		std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return comparisonFunction(entities[a], entities[b]); });
+		apply_order(order);
+	}
+
+	// Puts the entities that also have a component in leader into the order they have there, and the others
+	// behind them in their current order. Keeps containers that are iterated together in the same order.
+	template <class Leader>
+	void sort_like(const Leader& leader) {
+		std::vector<unsigned int> keys(entities.size());
+		for (size_t i = 0; i < entities.size(); i++) keys[i] = leader.index_of(entities[i]);
+		if (std::is_sorted(keys.begin(), keys.end())) return;
+		std::vector<unsigned int> order(entities.size());
+		std::iota(order.begin(), order.end(), 0u);
+		std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return keys[a] < keys[b]; });
+		apply_order(order);
 	}
 };
\ No newline at end of file
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <ecs/PagedSparseArray.hpp>
+
+// ComponentIndex<T>::value is the index of T in REGISTRY_COMPONENTS (see Registry.hpp). Using a type that is not in the list fails to compile.
+template <typename T>
+struct ComponentIndex;
+
+// One bit per component type (see ComponentIndex<T>), set while an entity has that component
+using ComponentMask = unsigned long long;
+
+// The component mask of every entity of a Registry, indexed by Entity::get_index()
+using EntitySignatures = PagedSparseArray<ComponentMask, 0>;
+
+// The change version of a Registry, raised every frame and by Registry::advance_change_version. Components remember
+// the version of their last change, so a system can ask which ones changed since the version it last looked at.
+using ChangeVersion = unsigned int;
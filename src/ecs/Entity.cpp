@@ -1,3 +1,44 @@
 #include <ecs/Entity.hpp>
 
-unsigned int Entity::id_count = 0;
\ No newline at end of file
+#include <assert.h>
+
+Entity::Pool Entity::pool;
+
+// Freed indices are only reused once this many are waiting, so the generation of a single index does not wrap around quickly
+static const unsigned int MIN_FREE_INDICES = 1024;
+
+Entity::Entity() {
+	unsigned int index;
+	if (pool.free_indices.size() > MIN_FREE_INDICES) {
+		index = pool.free_indices.front();
+		pool.free_indices.pop_front();
+	} else {
+		if (pool.generations.empty()) {
+			pool.generations.push_back(0); // reserve index 0 for the null entity
+		}
+		index = (unsigned int)pool.generations.size();
+		assert(index <= INDEX_MASK && "Ran out of entity indices");
+		pool.generations.push_back(0);
+	}
+	id = (pool.generations[index] << INDEX_BITS) | index;
+}
+
+void Entity::destroy(Entity e) {
+	if (!is_alive(e)) return;
+	unsigned int index = e.get_index();
+	pool.generations[index] = (pool.generations[index] + 1) & GENERATION_MASK;
+	pool.free_indices.push_back(index);
+}
+
+bool Entity::is_alive(Entity e) {
+	unsigned int index = e.get_index();
+	return index != 0 && index < pool.generations.size() && pool.generations[index] == e.get_generation();
+}
+
+Entity::Pool Entity::save_pool() {
+	return pool;
+}
+
+void Entity::restore_pool(const Pool& saved) {
+	pool = saved;
+}
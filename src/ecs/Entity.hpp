@@ -1,15 +1,49 @@
 #pragma once
 
+#include <deque>
+#include <vector>
+
+// A 32 bit handle made of an index and a generation. The low INDEX_BITS are the index, which is recycled
+// once the entity is destroyed, so arrays indexed by it stay as small as the number of live entities.
+// The high bits count how often that index was reused, so a handle kept after destroy() never matches
+// the entity that reuses its index.
 class Entity {
 	unsigned int id;
-	static unsigned int id_count;
+
+	explicit Entity(unsigned int id) : id(id) {}
 public:
-	Entity() {
-		id = ++id_count;
-	}
+	static constexpr unsigned int INDEX_BITS = 20;
+	static constexpr unsigned int INDEX_MASK = (1u << INDEX_BITS) - 1;
+	static constexpr unsigned int GENERATION_MASK = (1u << (32 - INDEX_BITS)) - 1;
+
+	// The index allocator. It is global, like the ids were, but can be saved and restored together with a world snapshot.
+	struct Pool {
+		std::vector<unsigned int> generations; // current generation of every index, index 0 is the null entity
+		std::deque<unsigned int> free_indices;
+	};
+
+	// Creates a new entity
+	Entity();
+
+	// A handle that refers to no entity, for members that are assigned later
+	static Entity null() { return Entity(0u); }
 
 	unsigned int get_id() const { return id; }
+	unsigned int get_index() const { return id & INDEX_MASK; }
+	unsigned int get_generation() const { return id >> INDEX_BITS; }
     
     // this enables automatic casting to int
 	operator unsigned int() { return id; }
-};
\ No newline at end of file
+
+	// Frees the index of e for reuse, every existing handle to e becomes stale. Does not touch any registry, see Registry::destroy.
+	static void destroy(Entity e);
+
+	// False for the null entity and for handles to destroyed entities
+	static bool is_alive(Entity e);
+
+	static Pool save_pool();
+	static void restore_pool(const Pool& saved);
+
+private:
+	static Pool pool;
+};
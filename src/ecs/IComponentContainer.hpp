@@ -1,6 +1,7 @@
 #pragma once
 
 #include <ecs/Entity.hpp>
+#include <ecs/MemoryUsage.hpp>
 
 #include <algorithm>
 #include <vector>
@@ -15,7 +16,12 @@ struct IComponentContainer
 	virtual void clear() = 0;
 	virtual size_t size() = 0;
 	virtual void remove(Entity e) = 0;
+	virtual void remove_batch(std::vector<Entity>& batch) = 0;
 	virtual bool has(Entity entity) = 0;
+	virtual void unshare() = 0;
+	virtual void reserve(size_t n) = 0;
+	virtual void shrink_to_fit() = 0;
+	virtual MemoryUsage memory_usage() const = 0;
 	virtual IComponentContainer& operator=(const IComponentContainer& other) = 0;
 };
 
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+
+// Memory of one component container, see Registry::memory_report. "bytes" is what the stored data needs,
+// "reserved" what the container keeps allocated for it.
+struct MemoryUsage {
+	size_t count = 0;
+	size_t component_bytes = 0;    // sizeof(Component) per stored component
+	size_t component_reserved = 0; // allocated component pages and their page table
+	size_t entity_bytes = 0;       // the entity list and the change versions
+	size_t entity_reserved = 0;
+	size_t index_bytes = 0;        // the pages of the sparse entity -> index map, or the bits of a tag
+	size_t owned_bytes = 0;        // heap memory the components own themselves, see owned_heap_bytes
+	size_t shared_bytes = 0;       // the part of component_reserved still shared with a snapshot, counted in both
+
+	size_t used() const {
+		return component_bytes + entity_bytes + index_bytes + owned_bytes;
+	}
+
+	size_t reserved() const {
+		return component_reserved + entity_reserved + index_bytes + owned_bytes;
+	}
+
+	MemoryUsage& operator+=(const MemoryUsage& other) {
+		count += other.count;
+		component_bytes += other.component_bytes;
+		component_reserved += other.component_reserved;
+		entity_bytes += other.entity_bytes;
+		entity_reserved += other.entity_reserved;
+		index_bytes += other.index_bytes;
+		owned_bytes += other.owned_bytes;
+		shared_bytes += other.shared_bytes;
+		return *this;
+	}
+};
+
+// Heap memory a component owns beyond sizeof(Component). Components with vectors or strings overload this next to
+// their definition, e.g. size_t owned_heap_bytes(const Projectile&), and ComponentContainer finds the overload.
+template <typename Component>
+inline size_t owned_heap_bytes(const Component&) {
+	return 0;
+}
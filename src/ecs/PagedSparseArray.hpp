@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+// A sparse array indexed by entity id. Storage is split in fixed-size pages that are
+// only allocated once an id in their range is written, so a few large ids do not force
+// one huge allocation, and reads of ids in untouched pages just return the empty value.
+// Like PagedVector, copies share their pages until one side writes to a page.
+template <typename Value, Value EmptyValue>
+class PagedSparseArray {
+public:
+	static constexpr unsigned int PAGE_BITS = 10;
+	static constexpr unsigned int PAGE_SIZE = 1u << PAGE_BITS;
+	static constexpr unsigned int PAGE_MASK = PAGE_SIZE - 1;
+
+	PagedSparseArray() {
+	}
+
+	PagedSparseArray(const PagedSparseArray& other) {
+		share(other);
+	}
+
+	PagedSparseArray& operator=(const PagedSparseArray& other) {
+		if (this != &other) share(other);
+		return *this;
+	}
+
+	// Returns the stored value, or EmptyValue if nothing was stored for this id
+	inline Value get(unsigned int id) const {
+		const unsigned int page = id >> PAGE_BITS;
+		if (page >= data.size() || !data[page]) {
+			return EmptyValue;
+		}
+		return data[page][id & PAGE_MASK];
+	}
+
+	// Returns a writable slot for this id, allocating its page (or copying a shared one) if needed
+	inline Value& at(unsigned int id) {
+		const unsigned int page = id >> PAGE_BITS;
+		if (page >= data.size()) {
+			pages.resize(page + 1);
+			data.resize(page + 1, nullptr);
+			shared.resize(page + 1, 0);
+		}
+		if (!data[page]) {
+			// size_t(PAGE_SIZE) passes a copy: make_shared takes references, and PAGE_SIZE has no definition outside the class in C++14
+			pages[page] = std::make_shared<std::vector<Value>>(size_t(PAGE_SIZE), EmptyValue);
+			data[page] = pages[page]->data();
+		} else if (shared_count > 0 && shared[page]) {
+			unshare(page);
+		}
+		return data[page][id & PAGE_MASK];
+	}
+
+	inline void set(unsigned int id, Value value) {
+		at(id) = value;
+	}
+
+	// Resets the slot of this id, never allocates a page for it
+	inline void reset(unsigned int id) {
+		if (get(id) != EmptyValue) {
+			at(id) = EmptyValue;
+		}
+	}
+
+	// Drops every page
+	void clear() {
+		pages.clear();
+		data.clear();
+		shared.clear();
+		shared_count = 0;
+	}
+
+	size_t page_count() const {
+		size_t count = 0;
+		for (const auto& page : pages) {
+			if (page) count++;
+		}
+		return count;
+	}
+
+	// The allocated pages and the page table
+	size_t allocated_bytes() const {
+		return page_count() * PAGE_SIZE * sizeof(Value)
+			+ pages.capacity() * sizeof(pages[0]) + data.capacity() * sizeof(data[0]) + shared.capacity();
+	}
+
+	// Frees the pages that only hold EmptyValue, e.g. after the entities of a large id range are gone.
+	// A shared page only loses this copy's reference.
+	void shrink_to_fit() {
+		for (size_t page = 0; page < pages.size(); page++) {
+			if (!data[page] || !std::all_of(data[page], data[page] + PAGE_SIZE, [](Value value) { return value == EmptyValue; })) continue;
+			if (shared[page]) {
+				shared[page] = 0;
+				shared_count--;
+			}
+			pages[page].reset();
+			data[page] = nullptr;
+		}
+		size_t size = pages.size();
+		while (size > 0 && !data[size - 1]) size--;
+		pages.resize(size);
+		data.resize(size);
+		shared.resize(size);
+		pages.shrink_to_fit();
+		data.shrink_to_fit();
+		shared.shrink_to_fit();
+	}
+
+private:
+	// Both arrays mark every page as shared, the first write to a page checks whether it still is
+	void share(const PagedSparseArray& other) {
+		pages = other.pages;
+		data = other.data;
+		shared.assign(pages.size(), 1);
+		shared_count = pages.size();
+		other.shared.assign(pages.size(), 1);
+		other.shared_count = pages.size();
+	}
+
+	void unshare(unsigned int page) {
+		if (pages[page].use_count() > 1) {
+			pages[page] = std::make_shared<std::vector<Value>>(*pages[page]);
+			data[page] = pages[page]->data();
+		}
+		shared[page] = 0;
+		shared_count--;
+	}
+
+	std::vector<std::shared_ptr<std::vector<Value>>> pages;
+	std::vector<Value*> data; // pages[i]->data(), or nullptr while the page is not allocated
+	mutable std::vector<unsigned char> shared; // set by copies until the next write to the page
+	mutable size_t shared_count = 0;
+};
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+// A vector split in fixed-size pages. Copies share the pages and a page is only duplicated when one of the
+// copies writes to it (copy-on-write), so copying is O(number of pages) and the cost of the copy is paid later,
+// page by page, for the data that actually changes. Elements never move when other elements are added.
+// Writing through a reference that was taken before the vector was copied also changes the copy, so take
+// references after the copy, as with iterators after an insert.
+template <typename Value>
+class PagedVector {
+public:
+	static constexpr unsigned int PAGE_BITS = 10;
+	static constexpr unsigned int PAGE_SIZE = 1u << PAGE_BITS;
+	static constexpr unsigned int PAGE_MASK = PAGE_SIZE - 1;
+
+	PagedVector() {
+	}
+
+	PagedVector(const PagedVector& other) {
+		share(other);
+	}
+
+	PagedVector(PagedVector&& other) {
+		take(other);
+	}
+
+	PagedVector& operator=(const PagedVector& other) {
+		if (this != &other) share(other);
+		return *this;
+	}
+
+	PagedVector& operator=(PagedVector&& other) {
+		if (this != &other) take(other);
+		return *this;
+	}
+
+	size_t size() const {
+		return count;
+	}
+
+	bool empty() const {
+		return count == 0;
+	}
+
+	// Read access, never copies a page
+	const Value& operator[](size_t i) const {
+		return data[i >> PAGE_BITS][i & PAGE_MASK];
+	}
+
+	// Write access, copies the page first if it is shared
+	Value& operator[](size_t i) {
+		const size_t page = i >> PAGE_BITS;
+		if (shared_count > 0 && shared[page]) unshare(page);
+		return data[page][i & PAGE_MASK];
+	}
+
+	Value& back() {
+		return (*this)[count - 1];
+	}
+
+	void push_back(Value&& value) {
+		const size_t page = count >> PAGE_BITS;
+		if (page == pages.size()) {
+			add_page();
+		} else if (shared_count > 0 && shared[page]) {
+			unshare(page);
+		}
+		pages[page]->push_back(std::move(value));
+		count++;
+	}
+
+	// The emptied pages are kept for the next push_back
+	void pop_back() {
+		const size_t page = (count - 1) >> PAGE_BITS;
+		if (shared_count > 0 && shared[page]) unshare(page);
+		pages[page]->pop_back();
+		count--;
+	}
+
+	// Allocates the pages for n elements up front, so a batch of push_backs does not allocate in between
+	void reserve(size_t n) {
+		while (pages.size() * PAGE_SIZE < n) add_page();
+	}
+
+	// Number of elements the allocated pages hold
+	size_t capacity() const {
+		return pages.size() * PAGE_SIZE;
+	}
+
+	// The allocated pages and the page table
+	size_t allocated_bytes() const {
+		return capacity() * sizeof(Value)
+			+ pages.capacity() * sizeof(pages[0]) + data.capacity() * sizeof(data[0]) + shared.capacity();
+	}
+
+	// Frees the pages behind the last element. A shared page only loses this copy's reference.
+	void shrink_to_fit() {
+		const size_t needed = (count + PAGE_MASK) >> PAGE_BITS;
+		for (size_t page = needed; page < pages.size(); page++) {
+			if (shared[page]) shared_count--;
+		}
+		pages.resize(needed);
+		data.resize(needed);
+		shared.resize(needed);
+		pages.shrink_to_fit();
+		data.shrink_to_fit();
+		shared.shrink_to_fit();
+	}
+
+	// Keeps the allocated pages unless they are shared with another copy
+	void clear() {
+		if (shared_count > 0) {
+			pages.clear();
+			data.clear();
+			shared.clear();
+			shared_count = 0;
+		} else {
+			for (auto& page : pages) page->clear();
+		}
+		count = 0;
+	}
+
+	// Copies every page that is still shared, so that later writes, even from several threads, never have to
+	void unshare_all() {
+		for (size_t page = 0; shared_count > 0 && page < pages.size(); page++) {
+			if (shared[page]) unshare(page);
+		}
+	}
+
+	// Number of pages that are still shared with another copy
+	size_t shared_page_count() const {
+		size_t result = 0;
+		for (const auto& page : pages) {
+			if (page.use_count() > 1) result++;
+		}
+		return result;
+	}
+
+private:
+	// Both vectors mark every page as shared, the first write to a page checks whether it still is
+	void share(const PagedVector& other) {
+		pages = other.pages;
+		data = other.data;
+		count = other.count;
+		shared.assign(pages.size(), 1);
+		shared_count = pages.size();
+		other.shared.assign(pages.size(), 1);
+		other.shared_count = pages.size();
+	}
+
+	// Moves the pages of other here and leaves it empty
+	void take(PagedVector& other) {
+		pages = std::move(other.pages);
+		data = std::move(other.data);
+		shared = std::move(other.shared);
+		shared_count = other.shared_count;
+		count = other.count;
+		other.pages.clear();
+		other.data.clear();
+		other.shared.clear();
+		other.shared_count = 0;
+		other.count = 0;
+	}
+
+	void add_page() {
+		pages.push_back(std::make_shared<std::vector<Value>>());
+		pages.back()->reserve(PAGE_SIZE);
+		data.push_back(pages.back()->data());
+		shared.push_back(0);
+	}
+
+	void unshare(size_t page) {
+		if (pages[page].use_count() > 1) {
+			auto copy = std::make_shared<std::vector<Value>>();
+			copy->reserve(PAGE_SIZE);
+			copy->insert(copy->end(), pages[page]->begin(), pages[page]->end());
+			pages[page] = std::move(copy);
+			data[page] = pages[page]->data();
+		}
+		shared[page] = 0;
+		shared_count--;
+	}
+
+	std::vector<std::shared_ptr<std::vector<Value>>> pages;
+	std::vector<Value*> data; // pages[i]->data(), stable because every page reserves PAGE_SIZE
+	mutable std::vector<unsigned char> shared; // set by copies until the next write to the page
+	mutable size_t shared_count = 0;
+	size_t count = 0;
+};
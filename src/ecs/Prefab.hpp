@@ -0,0 +1,59 @@
+#pragma once
+
+#include <ecs/Registry.hpp>
+
+#include <cassert>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A named template of default components, e.g.
+//     Prefab tree("tree");
+//     tree.with(Team{ TEAM_ID::NEUTRAL }).with(StaticObject{ STATIC_OBJECT_TYPE::TREE });
+// instantiate() gives a whole batch of entities copies of the defaults, one container at a time: each container
+// reserves room for the batch once and the batch fills it contiguously, instead of every entity visiting every
+// container in turn. See EntityFactory::spawn_batch.
+class Prefab {
+public:
+	explicit Prefab(std::string name)
+		: m_name(std::move(name)) {
+	}
+
+	// Adds a component with these defaults. Each component type may only be added once.
+	template <typename T>
+	Prefab& with(T component = T()) {
+		assert(!(m_mask & component_mask<T>()) && "Component added to the prefab twice");
+		m_mask |= component_mask<T>();
+		m_parts.push_back([component](Registry& registry, const std::vector<Entity>& entities) {
+			ComponentStorage<T>& container = registry.get_container<T>();
+			container.reserve(container.size() + entities.size());
+			for (Entity e : entities) container.insert(e, component);
+		});
+		return *this;
+	}
+
+	// Emplaces the default components on every entity of the batch
+	void instantiate(Registry& registry, const std::vector<Entity>& entities) const {
+		for (const auto& part : m_parts) part(registry, entities);
+	}
+
+	const std::string& name() const {
+		return m_name;
+	}
+
+	// The components the prefab adds
+	ComponentMask mask() const {
+		return m_mask;
+	}
+
+	template <typename T>
+	bool has() const {
+		return (m_mask & component_mask<T>()) != 0;
+	}
+
+private:
+	std::string m_name;
+	ComponentMask m_mask = 0;
+	std::vector<std::function<void(Registry&, const std::vector<Entity>&)>> m_parts;
+};
@@ -1,9 +1,16 @@
 #pragma once
 
 #include <ecs/ComponentContainer.hpp>
+#include <ecs/TagContainer.hpp>
+#include <ecs/View.hpp>
+#include <ecs/CommandBuffer.hpp>
 #include <components/Components.hpp>
 #include <ecs/IComponentContainer.hpp>
+#include <array>
+#include <atomic>
+#include <initializer_list>
 #include <optional>
+#include <ostream>
 
 #include <iostream>
 
@@ -18,92 +25,135 @@ struct InputState {
 
 struct NearInteractable {
 	bool is_active = false;
-	Entity interactable;
+	Entity interactable = Entity::null();
 	std::string message;
 };
 
 struct LockedTarget {
 	bool is_active = false;
-	Entity target;
+	Entity target = Entity::null();
 };
 
+// Where the NearPlayer and NearCamera tags were last rebuilt from, see GameplaySystem::update_near_player_camera
+struct NearTagsState {
+	ChangeVersion version = 0; // 0 forces a full rebuild
+	glm::vec2 player_pos = { 0.f, 0.f };
+	glm::vec2 camera_pos = { 0.f, 0.f };
+};
+
+// Every component type stored in the Registry, declared once as X(ComponentType, container_name).
+// The position in this list is the constexpr component index of the type, see ComponentIndex<T>.
+// Adding a component only needs a line here; the members, registration, copy and clear code is generated from it.
+// Empty marker structs are stored as bits instead of objects, see ComponentStorage<T>.
+#define REGISTRY_COMPONENTS(X) \
+	X(Motion, motions) \
+	X(ContinuousCollision, continuous_collisions) \
+	X(Attacker, attackers) \
+	X(LocomotionStats, locomotion_stats) \
+	X(Buff, buffs) \
+	X(Weapon, weapons) \
+	X(Projectile, projectiles) \
+	X(AttackCooldown, attack_cooldowns) \
+	X(Team, teams) \
+	X(MoveWith, move_withs) \
+	X(RotateWith, rotate_withs) \
+	X(TextureName, textures) \
+	X(CollisionBounds, collision_bounds) \
+	X(InDodge, in_dodges) \
+	X(AIComponent, ais) \
+	X(BossAI, boss_ais) \
+	X(NearPlayer, near_players) \
+	X(NearCamera, near_cameras) \
+	X(Wall, walls) \
+	X(Enemy, enemies) \
+	X(StaticObject, static_objects) \
+	X(StaggerCooldown, stagger_cooldowns) \
+	X(DeathCooldown, death_cooldowns) \
+	X(EnergyNoRegenCooldown, energy_no_regen_cooldowns) \
+	X(VisionToPlayer, vision_to_players) \
+	X(ProjectileModels, projectile_models) \
+	X(LightSource, light_sources) \
+	X(Interactable, interactables) \
+	X(Estus, estus) \
+	X(InRest, in_rests) \
+	X(AttackBuildup, buildups)
+
+enum class ComponentId : unsigned int {
+#define REGISTRY_COMPONENT_ID(Type, name) name,
+	REGISTRY_COMPONENTS(REGISTRY_COMPONENT_ID)
+#undef REGISTRY_COMPONENT_ID
+	count
+};
+
+constexpr unsigned int COMPONENT_COUNT = (unsigned int)ComponentId::count;
+
+#define REGISTRY_COMPONENT_INDEX(Type, name) \
+	template <> struct ComponentIndex<Type> { static constexpr unsigned int value = (unsigned int)ComponentId::name; };
+REGISTRY_COMPONENTS(REGISTRY_COMPONENT_INDEX)
+#undef REGISTRY_COMPONENT_INDEX
+
+static_assert(COMPONENT_COUNT <= sizeof(ComponentMask) * 8, "ComponentMask has fewer bits than there are component types");
+
+// A number per component type, indexed by component index, see Registry::component_counts
+using ComponentCounts = std::array<size_t, COMPONENT_COUNT>;
+
+// One row of Registry::memory_report
+struct ContainerMemory {
+	const char* name;
+	MemoryUsage usage;
+	bool shared = false; // shared by all registries, not part of Registry::total_memory
+};
+
+// The mask with the bits of the given component types set
+template <typename... Components>
+inline ComponentMask component_mask() {
+	ComponentMask mask = 0;
+	(void)std::initializer_list<int>{ (mask |= ComponentMask(1) << ComponentIndex<Components>::value, 0)... };
+	return mask;
+}
+
 class Registry {
+	// All containers, indexed by component index, for code that only knows the index at runtime
 	std::vector<IComponentContainer*> m_registry_list;
 
+	// Which components each entity has, kept up to date by the containers on every emplace and remove
+	EntitySignatures m_signatures; // indexed by Entity::get_index()
+
+	// Stamped on every component that is inserted or marked as changed, see change_version
+	ChangeVersion m_change_version = 1;
+
+	// Unique per registry instance, see id()
+	unsigned int m_id = next_id();
+
+	static unsigned int next_id() {
+		static std::atomic<unsigned int> counter{ 0 };
+		return ++counter;
+	}
+
 public:
 	float counter = 0;
 
-	ComponentContainer<Motion> motions;
-	ComponentContainer<Collision> collisions;
-	ComponentContainer<Attacker> attackers;
-	ComponentContainer<LocomotionStats> locomotion_stats;
-	ComponentContainer<Buff> buffs;
-	ComponentContainer<Weapon> weapons;
-	ComponentContainer<Projectile> projectiles;
-	ComponentContainer<AttackCooldown> attack_cooldowns;
-	ComponentContainer<Team> teams;
-	ComponentContainer<MoveWith> move_withs;
-	ComponentContainer<RotateWith> rotate_withs;
-	ComponentContainer<TextureName> textures;
-	ComponentContainer<CollisionBounds> collision_bounds;
-	ComponentContainer<InDodge> in_dodges;
-	ComponentContainer<AIComponent> ais;
-	ComponentContainer<BossAI> boss_ais;
-	ComponentContainer<NearPlayer> near_players;
-	ComponentContainer<NearCamera> near_cameras;
-	ComponentContainer<Wall> walls;
-	ComponentContainer<Enemy> enemies;
-	ComponentContainer<StaticObject> static_objects;
-	ComponentContainer<StaggerCooldown> stagger_cooldowns;
-	ComponentContainer<DeathCooldown> death_cooldowns;
-	ComponentContainer<EnergyNoRegenCooldown> energy_no_regen_cooldowns;
-	ComponentContainer<VisionToPlayer> vision_to_players;
-	ComponentContainer<ProjectileModels> projectile_models;
-	ComponentContainer<LightSource> light_sources;
-	ComponentContainer<Interactable> interactables;
-	ComponentContainer<Estus> estus;
-	ComponentContainer<InRest> in_rests;
-	ComponentContainer<AttackBuildup> buildups;
+#define REGISTRY_DECLARE_CONTAINER(Type, name) ComponentStorage<Type> name;
+	REGISTRY_COMPONENTS(REGISTRY_DECLARE_CONTAINER)
+#undef REGISTRY_DECLARE_CONTAINER
 	GridMap grid_map;
-	Entity player;
+	Entity player = Entity::null();
 	Inventory inventory;
 	NearInteractable near_interactable;
 	LockedTarget locked_target;
 	InputState input_state;
 	glm::vec2 camera_pos;
+	NearTagsState near_tags; // not copied by operator=, a restored registry rebuilds its tags
+
+	// Deferred removals and spawns of the current frame, not copied by operator=
+	CommandBuffer commands;
 
 	Registry() {
-		m_registry_list.push_back(&motions);
-		m_registry_list.push_back(&collisions);
-		m_registry_list.push_back(&attackers);
-		m_registry_list.push_back(&locomotion_stats);
-		m_registry_list.push_back(&buffs);
-		m_registry_list.push_back(&weapons);
-		m_registry_list.push_back(&projectiles);
-		m_registry_list.push_back(&attack_cooldowns);
-		m_registry_list.push_back(&teams);
-		m_registry_list.push_back(&move_withs);
-		m_registry_list.push_back(&rotate_withs);
-		m_registry_list.push_back(&textures);
-		m_registry_list.push_back(&collision_bounds);
-		m_registry_list.push_back(&in_dodges);
-		m_registry_list.push_back(&ais);
-		m_registry_list.push_back(&boss_ais);
-		m_registry_list.push_back(&near_players);
-		m_registry_list.push_back(&static_objects);
-		m_registry_list.push_back(&walls);
-		m_registry_list.push_back(&enemies);
-		m_registry_list.push_back(&near_cameras);
-		m_registry_list.push_back(&stagger_cooldowns);
-		m_registry_list.push_back(&death_cooldowns);
-		m_registry_list.push_back(&energy_no_regen_cooldowns);
-		m_registry_list.push_back(&vision_to_players);
-		m_registry_list.push_back(&projectile_models);
-		m_registry_list.push_back(&light_sources);
-		m_registry_list.push_back(&interactables);
-		m_registry_list.push_back(&estus);
-		m_registry_list.push_back(&in_rests);
-		m_registry_list.push_back(&buildups);
+#define REGISTRY_REGISTER_CONTAINER(Type, name) \
+		m_registry_list.push_back(&name); \
+		name.bind_signatures(&m_signatures, ComponentIndex<Type>::value, &m_change_version);
+		REGISTRY_COMPONENTS(REGISTRY_REGISTER_CONTAINER)
+#undef REGISTRY_REGISTER_CONTAINER
 
 		// create grid map entities
 		grid_map = GridMap();
@@ -115,13 +165,21 @@ public:
 		}
 	}
 
+	// The containers point back at this registry's signatures, so a registry can be assigned but not copy constructed
+	Registry(const Registry&) = delete;
+
+	// Used for the checkpoint snapshots in MapManager. The component pages are shared with other and only copied
+	// once either registry writes to them, so this costs about one entity list copy per container.
+	// Every component counts as changed afterwards, since systems may have looked at the replaced ones.
 	Registry& operator=(const Registry& other) {
 		if (this != &other) {
 			counter = other.counter;
+			m_change_version = std::max(m_change_version, other.m_change_version) + 1;
 
-			for (size_t i = 0; i < m_registry_list.size(); ++i) {
-				*m_registry_list[i] = *other.m_registry_list[i];
-			}
+#define REGISTRY_COPY_CONTAINER(Type, name) name.assign_data(other.name); name.mark_all_changed();
+			REGISTRY_COMPONENTS(REGISTRY_COPY_CONTAINER)
+#undef REGISTRY_COPY_CONTAINER
+			m_signatures = other.m_signatures;
 
 			grid_map = other.grid_map;
 			player = other.player;
@@ -129,6 +187,7 @@ public:
 			near_interactable = other.near_interactable;
 			input_state = other.input_state;
 			camera_pos = other.camera_pos;
+			near_tags = NearTagsState();
 
 		}
 		return *this;
@@ -139,67 +198,232 @@ public:
 	}
 
 	void clear_all_components() {
-		for (IComponentContainer* reg : m_registry_list)
-			reg->clear();
+#define REGISTRY_CLEAR_CONTAINER(Type, name) name.clear();
+		REGISTRY_COMPONENTS(REGISTRY_CLEAR_CONTAINER)
+#undef REGISTRY_CLEAR_CONTAINER
 	}
 
 	void list_all_components() {
 		printf("Debug info on all registry entries:\n");
-		for (IComponentContainer* reg : m_registry_list)
-			if (reg->size() > 0)
-				printf("%4d components of type %s\n", (int)reg->size(), typeid(*reg).name());
+#define REGISTRY_LIST_CONTAINER(Type, name) \
+		if (name.size() > 0) \
+			printf("%4d components of type %s\n", (int)name.size(), #Type);
+		REGISTRY_COMPONENTS(REGISTRY_LIST_CONTAINER)
+#undef REGISTRY_LIST_CONTAINER
+	}
+
+	// The number of components of each type
+	ComponentCounts component_counts() {
+		ComponentCounts counts;
+		for (unsigned int i = 0; i < COMPONENT_COUNT; i++)
+			counts[i] = m_registry_list[i]->size();
+		return counts;
+	}
+
+	// Memory of every component container, then the entity signatures, the grid map and the collider shapes.
+	// The collider shapes are shared by all registries, so they are not part of any one registry's total.
+	std::vector<ContainerMemory> memory_report() const {
+		std::vector<ContainerMemory> rows;
+#define REGISTRY_REPORT_CONTAINER(Type, name) rows.push_back({ #Type, name.memory_usage() });
+		REGISTRY_COMPONENTS(REGISTRY_REPORT_CONTAINER)
+#undef REGISTRY_REPORT_CONTAINER
+
+		MemoryUsage signatures;
+		signatures.index_bytes = m_signatures.allocated_bytes();
+		rows.push_back({ "EntitySignatures", signatures });
+
+		MemoryUsage grid;
+		grid.entity_reserved = grid_map.grid_boxes.capacity() * sizeof(grid_map.grid_boxes[0]);
+		for (const auto& row : grid_map.grid_boxes) {
+			grid.count += row.size();
+			grid.component_bytes += row.size() * sizeof(GridMap::GridBox);
+			grid.component_reserved += row.capacity() * sizeof(GridMap::GridBox);
+		}
+		grid.entity_bytes = grid.entity_reserved;
+		rows.push_back({ "GridMap", grid });
+
+		MemoryUsage shapes;
+		const ColliderShapeLibrary& library = ColliderShapeLibrary::get_instance();
+		shapes.count = library.wall_count() + library.mesh_count();
+		shapes.owned_bytes = library.memory_bytes();
+		rows.push_back({ "ColliderShapeLibrary", shapes, true });
+		return rows;
+	}
+
+	// The sum of memory_report without the shared collider shapes
+	MemoryUsage total_memory() const {
+		MemoryUsage total;
+		for (const ContainerMemory& row : memory_report()) {
+			if (!row.shared) total += row.usage;
+		}
+		return total;
+	}
+
+	// memory_report as CSV with a header line, sizes in bytes
+	void write_memory_csv(std::ostream& out) const {
+		out << "container,count,component_bytes,component_reserved,entity_bytes,entity_reserved,index_bytes,owned_bytes,shared_bytes,used,reserved,shared_by_all_registries\n";
+		for (const ContainerMemory& row : memory_report()) {
+			const MemoryUsage& u = row.usage;
+			out << row.name << ',' << u.count << ',' << u.component_bytes << ',' << u.component_reserved << ','
+				<< u.entity_bytes << ',' << u.entity_reserved << ',' << u.index_bytes << ',' << u.owned_bytes << ','
+				<< u.shared_bytes << ',' << u.used() << ',' << u.reserved() << ',' << (row.shared ? 1 : 0) << '\n';
+		}
+	}
+
+	// Makes room for counts[i] components of each type, e.g. the counts a map of the same kind ended up with last
+	// time, so that generating it grows no container step by step
+	void reserve(const ComponentCounts& counts) {
+		for (unsigned int i = 0; i < COMPONENT_COUNT; i++) {
+			if (counts[i] > 0) m_registry_list[i]->reserve(counts[i]);
+		}
+	}
+
+	// Returns the memory containers kept for components that are gone, e.g. after the dungeon's projectiles.
+	// Pages shared with a snapshot are only released by this registry.
+	void shrink_to_fit() {
+		for (IComponentContainer* container : m_registry_list)
+			container->shrink_to_fit();
+		m_signatures.shrink_to_fit();
 	}
 
 	void list_all_components_of(Entity e) {
 		printf("Debug info on components of entity %u:\n", (unsigned int)e);
-		for (IComponentContainer* reg : m_registry_list)
-			if (reg->has(e))
-				printf("type %s\n", typeid(*reg).name());
+#define REGISTRY_LIST_COMPONENT_OF(Type, name) \
+		if (name.has(e)) \
+			printf("type %s\n", #Type);
+		REGISTRY_COMPONENTS(REGISTRY_LIST_COMPONENT_OF)
+#undef REGISTRY_LIST_COMPONENT_OF
 	}
 
+	// Only visits the containers that are set in the entity's signature
 	void remove_all_components_of(Entity e) {
-		for (IComponentContainer* reg : m_registry_list)
-			reg->remove(e);
+		ComponentMask signature = m_signatures.get(e.get_index());
+		for (unsigned int i = 0; signature != 0; i++, signature >>= 1) {
+			if (signature & 1)
+				m_registry_list[i]->remove(e);
+		}
+	}
+
+	// Removes all components of the entity and frees its id for reuse. Use this for entities that are gone for good,
+	// remove_all_components_of for entities that live on in another registry.
+	void destroy(Entity e) {
+		remove_all_components_of(e);
+		Entity::destroy(e);
 	}
 
-	bool valid(Entity e) {
-		for (IComponentContainer* reg : m_registry_list) {
-			if (reg->has(e)) {
-				return true;
+	// Plays back everything recorded in commands: component removals and destroyed entities are grouped per
+	// container and removed in one sorted pass each, then the ids are freed and the spawns run.
+	void flush_commands() {
+		for (Entity e : commands.destroyed) {
+			ComponentMask signature = this->signature(e);
+			for (unsigned int i = 0; signature != 0; i++, signature >>= 1) {
+				if (signature & 1)
+					commands.removals_by_component[i].push_back(e);
 			}
 		}
-		return false;
+		for (unsigned int i = 0; i < COMPONENT_COUNT; i++) {
+			if (!commands.removals_by_component[i].empty())
+				m_registry_list[i]->remove_batch(commands.removals_by_component[i]);
+		}
+		for (Entity e : commands.destroyed) {
+			Entity::destroy(e);
+		}
+		// Spawns may record new commands, so run them from a local list
+		std::vector<std::function<void(Registry&)>> spawns;
+		spawns.swap(commands.spawns);
+		commands.clear();
+		for (auto& spawn : spawns) {
+			spawn(*this);
+		}
+	}
+
+	// True if the entity has any component
+	bool valid(Entity e) const {
+		return signature(e) != 0;
 	}
 
+	// True if the entity has a component of type T
 	template<typename T>
-	T* try_get_component(Entity e) {
-		auto* container = get_container<T>();
-		if (container && container->has(e)) {
-			return &container->get(e);
+	bool has(Entity e) const {
+		return (signature(e) >> ComponentIndex<T>::value) & 1;
+	}
+
+	// The component mask of the entity, 0 for stale handles
+	ComponentMask signature(Entity e) const {
+		return Entity::is_alive(e) ? m_signatures.get(e.get_index()) : 0;
+	}
+
+	// The version that changes made now are stamped with. A system that caches data derived from components
+	// remembers the version it last looked at and next time only redoes the entities that changed since, e.g.
+	//     const ChangeVersion since = m_cached_version;
+	//     m_cached_version = registry.change_version();
+	//     registry.view<Wall, Motion>().changed_since(since).each(...);
+	// Changes made in the same frame after the system ran carry the remembered version, so they are picked up
+	// next time, together with the few that were already handled. Cached version 0 visits everything.
+	ChangeVersion change_version() const {
+		return m_change_version;
+	}
+
+	// Identifies this registry for caches kept outside of it. Unlike its address, never reused by a later registry,
+	// whose change versions would start over. Not copied by operator=, which marks everything as changed anyway.
+	unsigned int id() const {
+		return m_id;
+	}
+
+	// Starts the next change version, called by World::step once per frame. Not thread safe, since every
+	// insert and mark_changed reads the version.
+	void advance_change_version() {
+		m_change_version++;
+	}
+
+	// Copies the shared snapshot pages of every component in mask, see ComponentContainer::unshare
+	void unshare_components(ComponentMask mask) {
+		for (unsigned int i = 0; mask != 0; i++, mask >>= 1) {
+			if (mask & 1)
+				m_registry_list[i]->unshare();
 		}
-		return nullptr;
 	}
 
+	// Call before touching these components from several threads, since get() would otherwise copy shared pages
+	template <typename... Components>
+	void unshare_components() {
+		unshare_components(component_mask<Components...>());
+	}
+
+	// Calls func(container) on every component container, in component index order
+	template<typename Func>
+	void for_each_container(Func func) {
+#define REGISTRY_VISIT_CONTAINER(Type, name) func(name);
+		REGISTRY_COMPONENTS(REGISTRY_VISIT_CONTAINER)
+#undef REGISTRY_VISIT_CONTAINER
+	}
+
+	// Direct access to the container of component type T, resolved at compile time
 	template<typename T>
-	T& get_or_emplace_component(Entity e) {
-		auto* container = get_container<T>();
-		if (container) {
-			if (container->has(e)) {
-				return container->get(e);
-			}
-			return container->emplace(e);
-		}
-		throw std::runtime_error("Component type not registered");
+	ComponentStorage<T>& get_container();
+
+	// Iterates all entities that have every one of the Components, see View
+	template<typename... Components>
+	View<Registry, Include<Components...>, Exclude<>> view() {
+		return View<Registry, Include<Components...>, Exclude<>>(*this);
 	}
 
-private:
 	template<typename T>
-	ComponentContainer<T>* get_container() {
-		for (auto* container : m_registry_list) {
-			if (auto* typed = dynamic_cast<ComponentContainer<T>*>(container)) {
-				return typed;
-			}
+	T* try_get_component(Entity e) {
+		return get_container<T>().try_get(e);
+	}
+
+	template<typename T>
+	T& get_or_emplace_component(Entity e) {
+		ComponentStorage<T>& container = get_container<T>();
+		if (T* component = container.try_get(e)) {
+			return *component;
 		}
-		return nullptr;
+		return container.emplace(e);
 	}
-};
\ No newline at end of file
+};
+
+#define REGISTRY_CONTAINER_ACCESS(Type, name) \
+	template<> inline ComponentStorage<Type>& Registry::get_container<Type>() { return name; }
+REGISTRY_COMPONENTS(REGISTRY_CONTAINER_ACCESS)
+#undef REGISTRY_CONTAINER_ACCESS
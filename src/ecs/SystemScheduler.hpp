@@ -0,0 +1,153 @@
+#pragma once
+
+#include <ecs/ComponentMask.hpp>
+#include <ecs/Registry.hpp>
+
+#include <utils/JobSystem.hpp>
+#include <utils/Profiler.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Registry state besides the components that systems read or write
+enum class SystemResource : unsigned int {
+	Structure,   // emplaces or removes components, or creates entities (entity signatures and the entity pool)
+	Commands,    // records into Registry::commands
+	GridMap,
+	InputState,
+	Interaction, // near_interactable and locked_target
+	Audio,       // the AudioSystem singleton
+};
+
+// What a system reads and writes. Two systems conflict if one writes something the other reads or writes.
+struct SystemAccess {
+	ComponentMask reads = 0;
+	ComponentMask writes = 0;
+	unsigned int resource_reads = 0;
+	unsigned int resource_writes = 0;
+	bool exclusive = false;
+
+	template <typename... Components>
+	SystemAccess& read() {
+		reads |= component_mask<Components...>();
+		return *this;
+	}
+
+	template <typename... Components>
+	SystemAccess& write() {
+		writes |= component_mask<Components...>();
+		return *this;
+	}
+
+	SystemAccess& read(SystemResource resource) {
+		resource_reads |= 1u << (unsigned int)resource;
+		return *this;
+	}
+
+	SystemAccess& write(SystemResource resource) {
+		resource_writes |= 1u << (unsigned int)resource;
+		return *this;
+	}
+
+	// Conflicts with every other system, for systems that touch too much to list or may replace the active registry
+	static SystemAccess all() {
+		SystemAccess access;
+		access.exclusive = true;
+		return access;
+	}
+
+	bool conflicts_with(const SystemAccess& other) const {
+		if (exclusive || other.exclusive) return true;
+		if ((writes & (other.reads | other.writes)) || (other.writes & reads)) return true;
+		return (resource_writes & (other.resource_reads | other.resource_writes)) || (other.resource_writes & resource_reads);
+	}
+};
+
+// Runs the systems of World::step. Each system is placed in the first stage after every earlier system it
+// conflicts with, so the systems of one stage never touch the same data and run concurrently on the job system,
+// while conflicting systems keep the order they were added in. The result does not depend on the thread timing,
+// so a frame is as deterministic as with a single thread.
+class SystemScheduler {
+public:
+	using SystemFunc = std::function<void(float elapsed_ms)>;
+	using RegistrySource = std::function<Registry&()>;
+
+	// active_registry is asked again before every stage, since a system may switch or restart the map
+	SystemScheduler(RegistrySource active_registry)
+		: active_registry(std::move(active_registry)) {
+	}
+
+	void add(const std::string& name, const SystemAccess& access, SystemFunc func) {
+		systems.push_back({ name, Profiler::intern(name), access, std::move(func) });
+		stages_dirty = true;
+	}
+
+	// Runs every system once
+	void run(float elapsed_ms) {
+		if (stages_dirty) build_stages();
+
+		for (const Stage& stage : stages) {
+			if (stage.systems.size() == 1 || !JobSystem::get()) {
+				for (size_t system : stage.systems) run_system(systems[system], elapsed_ms);
+				continue;
+			}
+			// Reading a component page that is still shared with a snapshot would copy it, which is a write
+			active_registry().unshare_components(stage.reads);
+			JobSystem::get()->parallel_for(0, stage.systems.size(), 1, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) run_system(systems[stage.systems[i]], elapsed_ms);
+			});
+		}
+	}
+
+	// The names of the systems in each stage, for debugging the declared access
+	std::vector<std::vector<std::string>> describe_stages() {
+		if (stages_dirty) build_stages();
+		std::vector<std::vector<std::string>> result;
+		for (const Stage& stage : stages) {
+			result.emplace_back();
+			for (size_t system : stage.systems) result.back().push_back(systems[system].name);
+		}
+		return result;
+	}
+
+private:
+	struct System {
+		std::string name;
+		const char* zone_name; // the name as a profiler zone
+		SystemAccess access;
+		SystemFunc func;
+	};
+
+	struct Stage {
+		std::vector<size_t> systems;
+		ComponentMask reads = 0; // components read by any system of the stage
+	};
+
+	RegistrySource active_registry;
+	std::vector<System> systems;
+	std::vector<Stage> stages;
+	bool stages_dirty = false;
+
+	static void run_system(const System& system, float elapsed_ms) {
+		PROFILE_ZONE(system.zone_name);
+		system.func(elapsed_ms);
+	}
+
+	void build_stages() {
+		stages.clear();
+		std::vector<size_t> stage_of(systems.size(), 0);
+		for (size_t i = 0; i < systems.size(); i++) {
+			size_t stage = 0;
+			for (size_t j = 0; j < i; j++) {
+				if (systems[i].access.conflicts_with(systems[j].access)) stage = std::max(stage, stage_of[j] + 1);
+			}
+			stage_of[i] = stage;
+			if (stage >= stages.size()) stages.resize(stage + 1);
+			stages[stage].systems.push_back(i);
+			stages[stage].reads |= systems[i].access.reads;
+		}
+		stages_dirty = false;
+	}
+};
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <ecs/Entity.hpp>
+#include <ecs/IComponentContainer.hpp>
+#include <ecs/ComponentContainer.hpp>
+#include <ecs/ComponentMask.hpp>
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+// The container of an empty marker component such as NearPlayer. Instead of one empty struct per entity it keeps
+// one bit per entity index, plus the compact list of tagged entities for iteration. has() is a bit test and clear()
+// is a fill of the bit words, so tags that are rebuilt every frame cost no hashing and no per-entity allocation.
+// The bits are indexed like the entity signatures, so a handle is only tagged while it is alive (see Entity::is_alive).
+template <typename Tag>
+class TagContainer : public IComponentContainer {
+	static_assert(std::is_empty<Tag>::value, "TagContainer only stores empty marker structs, use ComponentContainer");
+
+	using Word = unsigned long long;
+	static constexpr unsigned int WORD_BITS = sizeof(Word) * 8;
+
+	// Bit i is set while the entity with index i has the tag
+	std::vector<Word> bits;
+
+	// The signatures of the owning Registry and the bit of this component type in them, see bind_signatures
+	EntitySignatures* signatures = nullptr;
+	ComponentMask signature_bit = 0;
+
+	// Tags carry no data to change, so change tracking is per container: the version of the last tag added or removed
+	const ChangeVersion* current_version = nullptr;
+	ChangeVersion last_change_version = 0;
+
+	void touch() {
+		last_change_version = current_version ? *current_version : 1;
+	}
+
+	// Every tagged entity gets a reference to the same instance, there is nothing to store per entity
+	Tag tag;
+
+	bool test(unsigned int index) const {
+		const unsigned int word = index / WORD_BITS;
+		return word < bits.size() && (bits[word] >> (index % WORD_BITS)) & 1;
+	}
+
+	void set_bit(unsigned int index) {
+		const unsigned int word = index / WORD_BITS;
+		if (word >= bits.size()) bits.resize(word + 1, 0);
+		bits[word] |= Word(1) << (index % WORD_BITS);
+	}
+
+	void reset_bit(unsigned int index) {
+		bits[index / WORD_BITS] &= ~(Word(1) << (index % WORD_BITS));
+	}
+
+	void clear_signature_bits() {
+		if (!signatures) return;
+		for (Entity e : entities)
+			signatures->at(e.get_index()) &= ~signature_bit;
+	}
+
+	void set_signature_bits() {
+		if (!signatures) return;
+		for (Entity e : entities)
+			signatures->at(e.get_index()) |= signature_bit;
+	}
+
+	// Swap-and-pop of the member list, the bits have to be reset by the caller
+	void remove_from_list(unsigned int entity_id) {
+		for (size_t i = entities.size(); i-- > 0;) {
+			if (entities[i].get_id() == entity_id) {
+				entities[i] = entities.back();
+				entities.pop_back();
+				return;
+			}
+		}
+	}
+public:
+	// The tagged entities, in insertion order until the first removal
+	std::vector<Entity> entities;
+
+	TagContainer() {
+	}
+
+	// Copies the tags but not the signature binding, which stays with the owning Registry
+	TagContainer(const TagContainer& other)
+		: last_change_version(other.last_change_version),
+		  bits(other.bits),
+		  entities(other.entities) {
+	}
+
+	// Keeps bit component_index of the registry's entity signatures in sync with this container, see ComponentContainer.
+	// The binding belongs to the container and is not copied by operator=.
+	void bind_signatures(EntitySignatures* entity_signatures, unsigned int component_index, const ChangeVersion* change_version) {
+		signatures = entity_signatures;
+		signature_bit = ComponentMask(1) << component_index;
+		current_version = change_version;
+		set_signature_bits();
+	}
+
+	IComponentContainer& operator=(const IComponentContainer& other) override {
+		if (this != &other) {
+			const auto* derived = dynamic_cast<const TagContainer<Tag>*>(&other);
+			if (derived) {
+				*this = *derived;
+			}
+		}
+		return *this;
+	}
+
+	TagContainer& operator=(const TagContainer& other) {
+		if (this != &other) {
+			clear_signature_bits();
+			assign_data(other);
+			set_signature_bits();
+		}
+		return *this;
+	}
+
+	// Copies the tags without updating the signatures, see ComponentContainer::assign_data
+	void assign_data(const TagContainer& other) {
+		last_change_version = other.last_change_version;
+		bits = other.bits;
+		entities = other.entities;
+	}
+
+	// Tags e, same interface as ComponentContainer::insert
+	inline Tag& insert(Entity e, Tag, bool check_for_duplicates = true) {
+		assert(!(check_for_duplicates && has(e)) && "Entity already contained in ECS registry");
+
+		set_bit(e.get_index());
+		if (signatures) signatures->at(e.get_index()) |= signature_bit;
+		entities.push_back(e);
+		touch();
+		return tag;
+	}
+
+	template<typename... Args>
+	Tag& emplace(Entity e, Args &&... args) {
+		return insert(e, Tag(std::forward<Args>(args)...));
+	}
+	template<typename... Args>
+	Tag& emplace_with_duplicates(Entity e, Args &&... args) {
+		return insert(e, Tag(std::forward<Args>(args)...), false);
+	}
+
+	// Tags e unless it already is
+	void set(Entity e) {
+		if (!has(e)) insert(e, Tag(), false);
+	}
+
+	Tag& get(Entity e) {
+		assert(has(e) && "Entity not contained in ECS registry");
+		return tag;
+	}
+
+	Tag& get(unsigned int entity_id) {
+		assert(std::any_of(entities.begin(), entities.end(), [&](const Entity& e) { return e.get_id() == entity_id; }) && "Entity not contained in ECS registry");
+		return tag;
+	}
+
+	Tag* try_get(Entity e) {
+		return has(e) ? &tag : nullptr;
+	}
+
+	bool has(Entity entity) {
+		return test(entity.get_index()) && Entity::is_alive(entity);
+	}
+
+	// Untags the entity. The bit is cleared directly, the member list is searched from the back.
+	void remove(unsigned int entity_id) {
+		const unsigned int index = entity_id & Entity::INDEX_MASK;
+		if (!test(index)) return;
+		const size_t count = entities.size();
+		remove_from_list(entity_id);
+		if (entities.size() == count) return; // a stale id whose index is tagged again
+		reset_bit(index);
+		if (signatures) signatures->at(index) &= ~signature_bit;
+		touch();
+	}
+
+	void remove(Entity e) {
+		remove((unsigned int)e);
+	}
+
+	// Resets the bits of the whole batch first, then compacts the member list in a single pass
+	void remove_batch(std::vector<Entity>& batch) override {
+		bool any = false;
+		for (Entity e : batch) {
+			if (has(e)) {
+				reset_bit(e.get_index());
+				if (signatures) signatures->at(e.get_index()) &= ~signature_bit;
+				any = true;
+			}
+		}
+		if (!any) return;
+		touch();
+		entities.erase(std::remove_if(entities.begin(), entities.end(), [&](const Entity& e) { return !test(e.get_index()); }), entities.end());
+	}
+
+	// Untags every entity. The bit words are kept allocated for the next frame.
+	void clear() {
+		clear_signature_bits();
+		if (!entities.empty()) touch();
+		std::fill(bits.begin(), bits.end(), Word(0));
+		entities.clear();
+	}
+
+	void mark_changed(Entity) {
+		touch();
+	}
+
+	// True if e is tagged and any tag was added or removed at the given version or later
+	bool changed_since(Entity e, ChangeVersion version) const {
+		return last_change_version >= version && test(e.get_index()) && Entity::is_alive(e);
+	}
+
+	void mark_all_changed() {
+		touch();
+	}
+
+	// Tags are never shared with a snapshot
+	void unshare() override {
+	}
+
+	size_t size() {
+		return entities.size();
+	}
+
+	// Makes room for n tagged entities in total, see Prefab and Registry::reserve
+	void reserve(size_t n) override {
+		entities.reserve(n);
+	}
+
+	// Frees the member list capacity and the bit words behind the highest tagged index
+	void shrink_to_fit() override {
+		entities.shrink_to_fit();
+		size_t size = bits.size();
+		while (size > 0 && bits[size - 1] == 0) size--;
+		bits.resize(size);
+		bits.shrink_to_fit();
+	}
+
+	MemoryUsage memory_usage() const override {
+		MemoryUsage usage;
+		usage.count = entities.size();
+		usage.entity_bytes = entities.size() * sizeof(Entity);
+		usage.entity_reserved = entities.capacity() * sizeof(Entity);
+		usage.index_bytes = bits.capacity() * sizeof(Word);
+		return usage;
+	}
+
+	// Sorts the member list, there is nothing else to re-arrange
+	template <class Compare>
+	void sort(Compare comparisonFunction) {
+		std::sort(entities.begin(), entities.end(), comparisonFunction);
+	}
+
+	// Orders the member list like leader, see ComponentContainer::sort_like
+	template <class Leader>
+	void sort_like(const Leader& leader) {
+		std::stable_sort(entities.begin(), entities.end(), [&](const Entity& a, const Entity& b) { return leader.index_of(a) < leader.index_of(b); });
+	}
+};
+
+// The container the Registry uses for component type T: a TagContainer for empty marker structs, a ComponentContainer otherwise
+template <typename T>
+using ComponentStorage = typename std::conditional<std::is_empty<T>::value, TagContainer<T>, ComponentContainer<T>>::type;
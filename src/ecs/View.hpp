@@ -0,0 +1,95 @@
+#pragma once
+
+#include <ecs/Entity.hpp>
+#include <ecs/TagContainer.hpp>
+
+#include <initializer_list>
+#include <tuple>
+#include <vector>
+
+template <typename... Components> struct Include {};
+template <typename... Components> struct Exclude {};
+
+template <typename Owner, typename Included, typename Excluded>
+class View;
+
+// A join over several component containers, e.g.
+//     registry.view<Motion, LocomotionStats>().exclude<DeathCooldown>().each([&](Entity e, Motion& motion, LocomotionStats& loco) { ... });
+// Iteration is driven by the smallest included container and every other container is looked up once per entity.
+// Entities are visited back to front, so the callback may remove the current entity (or add new ones) from any container.
+// changed_since(version) narrows the view to entities where any included component changed at that version or later.
+template <typename Owner, typename... Components, typename... Excluded>
+class View<Owner, Include<Components...>, Exclude<Excluded...>> {
+	static_assert(sizeof...(Components) > 0, "A view needs at least one component type to iterate");
+
+	Owner& m_owner;
+	std::tuple<ComponentStorage<Components>*...> m_included;
+	std::tuple<ComponentStorage<Excluded>*...> m_excluded;
+	ChangeVersion m_since = 0; // 0 visits every entity
+
+	template <typename, typename, typename> friend class View;
+
+	static bool _all_of(std::initializer_list<bool> values) {
+		for (bool value : values) {
+			if (!value) return false;
+		}
+		return true;
+	}
+
+	const std::vector<Entity>& _smallest() const {
+		const std::vector<Entity>* smallest = nullptr;
+		(void)std::initializer_list<int>{ (
+			smallest = (!smallest || std::get<ComponentStorage<Components>*>(m_included)->entities.size() < smallest->size())
+				? &std::get<ComponentStorage<Components>*>(m_included)->entities
+				: smallest,
+			0)... };
+		return *smallest;
+	}
+
+public:
+	View(Owner& owner)
+		: m_owner(owner),
+		  m_included(&owner.template get_container<Components>()...),
+		  m_excluded(&owner.template get_container<Excluded>()...) {
+	}
+
+	// Returns the same view, additionally skipping entities that have any of the Others components
+	template <typename... Others>
+	View<Owner, Include<Components...>, Exclude<Excluded..., Others...>> exclude() const {
+		View<Owner, Include<Components...>, Exclude<Excluded..., Others...>> result(m_owner);
+		result.m_since = m_since;
+		return result;
+	}
+
+	// Returns the same view, only visiting entities where an included component was inserted or marked as changed
+	// at version or later (see Registry::change_version)
+	View changed_since(ChangeVersion version) const {
+		View result = *this;
+		result.m_since = version;
+		return result;
+	}
+
+	// Calls func(Entity, Components&...) for every entity that has all included and none of the excluded components
+	template <typename Func>
+	void each(Func func) {
+		const std::vector<Entity>& driver = _smallest();
+		for (size_t i = driver.size(); i-- > 0;) {
+			// The callback may have removed more than one entity from the driving container
+			if (i >= driver.size()) continue;
+
+			Entity e = driver[i];
+			if (!_all_of({ !std::get<ComponentStorage<Excluded>*>(m_excluded)->has(e)... })) continue;
+			if (m_since != 0 && _all_of({ !std::get<ComponentStorage<Components>*>(m_included)->changed_since(e, m_since)... })) continue;
+
+			std::tuple<Components*...> found(std::get<ComponentStorage<Components>*>(m_included)->try_get(e)...);
+			if (!_all_of({ (std::get<Components*>(found) != nullptr)... })) continue;
+
+			func(e, *std::get<Components*>(found)...);
+		}
+	}
+
+	// Upper bound of the number of entities each() visits
+	size_t size_hint() const {
+		return _smallest().size();
+	}
+};
@@ -26,4 +26,6 @@ namespace Globals {
     void* ptr_window = nullptr;
     bool show_loading_screen = false;
     bool in_pause = true;
+    bool show_profiler = false;
+    bool show_memory = false;
 }
\ No newline at end of file
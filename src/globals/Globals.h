@@ -37,4 +37,6 @@ namespace Globals {
     extern void* ptr_window;
     extern bool show_loading_screen;
     extern bool in_pause;
+    extern bool show_profiler;
+    extern bool show_memory;
 }
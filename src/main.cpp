@@ -5,6 +5,7 @@
 #include <utils/Log.hpp>
 #include <app/Application.hpp>
 #include <Testing.hpp>
+#include <Benchmarks.hpp>
 
 #include <ft2build.h>
 #include <freetype/freetype.h>
@@ -22,6 +23,21 @@ int main(void) {
         Application app;
         app.run_game_loop();
         // Testing::try_assimp();
+        // Benchmarks::component_container_lookup();
+        // Benchmarks::registry_view_iteration();
+        // Benchmarks::tag_container_rebuild();
+        // Benchmarks::registry_snapshot();
+        // Benchmarks::motion_integration();
+        // Benchmarks::job_system_stress();
+        // Benchmarks::job_system_scaling();
+        // Benchmarks::spatial_sort_collisions();
+        // Benchmarks::prefab_spawn();
+        // Benchmarks::spatial_hash_broad_phase();
+        // Benchmarks::static_collider_broad_phase();
+        // Benchmarks::circle_narrow_phase();
+        // Benchmarks::collision_threading();
+        // Benchmarks::projectile_tunneling();
+        // Benchmarks::collision_queries();
     } catch (const std::exception& e) {
         const std::string message = std::string(e.what());
         Log::log_error_and_terminate(message, __FILE__, __LINE__);
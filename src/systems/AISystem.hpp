@@ -4,40 +4,47 @@
 
 #include "app/MapManager.hpp"
 #include "GameplaySystem.hpp"
+#include "CollisionWorld.hpp"
 #include "../ecs/Entity.hpp"
 #include "../components/Components.hpp"
 #include "../ecs/Registry.hpp"
 #include "utils/Common.hpp"
 #include "utils/PathFinder.hpp"
+#include "utils/JobSystem.hpp"
+#include "utils/FrameArena.hpp"
 
 namespace AISystem
 {
     inline void update_player_vision(float elapsed_ms) {
         Registry& registry = MapManager::get_instance().get_active_registry();
 
-        for (Entity& e : registry.ais.entities) {
-            if (!registry.near_players.has(e)) {
-                continue;
+        FrameVector<Entity> seers;
+        FrameVector<glm::vec2> positions;
+        registry.view<AIComponent, NearPlayer, Motion, CollisionBounds>().each([&](Entity e, AIComponent&, NearPlayer&, Motion& motion, CollisionBounds&) {
+            seers.push_back(e);
+            positions.push_back(motion.position);
+        });
+
+        // Walls and static objects block the view, characters do not. The rays only read the colliders, so they run
+        // in parallel. Acting on the result emplaces and removes components, which stays on this thread.
+        glm::vec2 target_position = registry.motions.get(registry.player).position;
+        FrameVector<char> sees_player(seers.size(), 0);
+        JobSystem::parallel_for_each_chunk(0, seers.size(), 8, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                sees_player[i] = CollisionSystem::line_of_sight(positions[i], target_position, CollisionSystem::QueryScope::Static,
+                                                                [](Entity) { return true; });
             }
-            Motion& motion = registry.motions.get(e);
+        });
 
-            glm::vec2 ai_position = get_grid_map_coordinates(motion);
-            glm::vec2 target_position = get_grid_map_coordinates(registry.motions.get(registry.player));
-            CollisionBounds ai_box = registry.collision_bounds.get(e);
-
-            int collision_radius = 0;
-            if (ai_box.type == ColliderType::Circle) {
-                collision_radius = ai_box.circle.radius;
-            }
-
-            bool can_see_player = can_see(registry.grid_map.grid_boxes, ai_position.x, ai_position.y, collision_radius, target_position.x, target_position.y);
-            if (registry.vision_to_players.has(e)) {
-                auto& vision_to_player = registry.vision_to_players.get(e);
+        for (size_t i = 0; i < seers.size(); i++) {
+            Entity e = seers[i];
+            bool can_see_player = sees_player[i] != 0;
+            if (VisionToPlayer* vision_to_player = registry.vision_to_players.try_get(e)) {
                 if (can_see_player) {
-                    vision_to_player.timer = 5.0f;
+                    vision_to_player->timer = 5.0f;
                 } else {
-                    vision_to_player.timer -= elapsed_ms / 1000.0f;
-                    if (vision_to_player.timer <= 0) {
+                    vision_to_player->timer -= elapsed_ms / 1000.0f;
+                    if (vision_to_player->timer <= 0) {
                         registry.attack_cooldowns.remove(e);
                     }
                 }
@@ -62,49 +69,15 @@ namespace AISystem
                 vec.x * sin_theta + vec.y * cos_theta
         };
     }
-//    I didn't know where to put this, so I put it here for now
-    inline bool is_gonna_collide(Entity& nearby_entity, Entity& ai_entity, glm::vec2 next_position) {
+    // Whether the agent runs into another collider within the next second at velocity. Projectiles are not obstacles.
+    inline bool is_gonna_collide(Entity& ai_entity, const Motion& motion, glm::vec2 velocity) {
         Registry& registry = MapManager::get_instance().get_active_registry();
-        if (!registry.motions.has(nearby_entity)) {
-            return false;
-        }
-        if (!registry.collision_bounds.has(nearby_entity)) {
-            return false;
-        }
-        Motion& motion = registry.motions.get(nearby_entity);
-        const CollisionBounds& nearby_bounds = registry.collision_bounds.get(nearby_entity);
         const CollisionBounds& ai_bounds = registry.collision_bounds.get(ai_entity);
-        float distance = glm::length(next_position - motion.position);
-        
-        // Get combined radius for broad phase check
-        float combined_radius = 0.0f;
-        if (nearby_bounds.type == ColliderType::Circle && ai_bounds.type == ColliderType::Circle) {
-            combined_radius = nearby_bounds.circle.radius + ai_bounds.circle.radius + 5.0f;
-        } else {
-            // For non-circle colliders, use conservative estimate
-            if (nearby_bounds.type == ColliderType::Circle) {
-                combined_radius += nearby_bounds.circle.radius;
-            } else if (nearby_bounds.type == ColliderType::Wall) {
-                combined_radius += glm::length(nearby_bounds.wall->aabb.max - nearby_bounds.wall->aabb.min) * 0.5f;
-            } else if (nearby_bounds.type == ColliderType::Mesh) {
-                combined_radius += nearby_bounds.mesh->bound_radius;
-            }
-            
-            if (ai_bounds.type == ColliderType::Circle) {
-                combined_radius += ai_bounds.circle.radius;
-            } else if (ai_bounds.type == ColliderType::Wall) {
-                combined_radius += glm::length(ai_bounds.wall->aabb.max - ai_bounds.wall->aabb.min) * 0.5f;
-            } else if (ai_bounds.type == ColliderType::Mesh) {
-                combined_radius += ai_bounds.mesh->bound_radius;
-            }
-            
-            combined_radius += 5.0f;
-        }
-        
-        if (distance < combined_radius) {
-            return true;
-        }
-        return false;
+        CollisionSystem::CastHit hit;
+        return CollisionSystem::circle_cast(motion.position, motion.position + velocity, CollisionSystem::broad_phase_radius(ai_bounds),
+                                            CollisionSystem::QueryScope::All, [&](Entity other) {
+            return other.get_id() != ai_entity.get_id() && !registry.projectiles.has(other);
+        }, hit);
     }
 
 // This function should be refactored. It doesn't work properly right now, it needs a better algorithm.
@@ -113,24 +86,21 @@ namespace AISystem
         Motion& motion = registry.motions.get(e);
         glm::vec2 dir = Common::normalize(ai.target_position - motion.position);
         glm::vec2 velocity = registry.locomotion_stats.get(e).movement_speed * dir;
-        for (Entity& nearby_entity : registry.near_players.entities) {
-            glm::vec2 next_position = motion.position + motion.velocity;
-            if (is_gonna_collide(nearby_entity, e, next_position)) {
-                for (int degree = 0; degree < 180; degree += 30) {
-                    glm::vec2 rotated_dir = rotate_vector(dir, float(degree));
-                    glm::vec2 rotated_velocity = registry.locomotion_stats.get(e).movement_speed * rotated_dir;
-                    if (!is_gonna_collide(nearby_entity, e, motion.position + rotated_velocity)) {
-                        velocity = rotated_velocity;
-                        break;
-                    }
-                    rotated_dir = rotate_vector(dir, float(-1 * degree));
-                    rotated_velocity = registry.locomotion_stats.get(e).movement_speed * rotated_dir;
-                    if (!is_gonna_collide(nearby_entity, e, motion.position + rotated_velocity)) {
-                        velocity = rotated_velocity;
-                        break;
-                    }
+        if (is_gonna_collide(e, motion, motion.velocity)) {
+            // Probe directions further and further away from the target, alternating sides
+            for (int degree = 0; degree < 180; degree += 30) {
+                glm::vec2 rotated_dir = rotate_vector(dir, float(degree));
+                glm::vec2 rotated_velocity = registry.locomotion_stats.get(e).movement_speed * rotated_dir;
+                if (!is_gonna_collide(e, motion, rotated_velocity)) {
+                    velocity = rotated_velocity;
+                    break;
+                }
+                rotated_dir = rotate_vector(dir, float(-1 * degree));
+                rotated_velocity = registry.locomotion_stats.get(e).movement_speed * rotated_dir;
+                if (!is_gonna_collide(e, motion, rotated_velocity)) {
+                    velocity = rotated_velocity;
+                    break;
                 }
-                break;
             }
         }
         return velocity;
@@ -152,22 +122,16 @@ namespace AISystem
         ai.target_position = player_position;
     }
 
-    inline void AI_patrol_step(Entity& e) {
-        Registry& registry = MapManager::get_instance().get_active_registry();
-        Motion& motion = registry.motions.get(e);
-        AIComponent& ai = registry.ais.get(e);
-
+    inline void AI_patrol_step(Motion& motion, AIComponent& ai, LocomotionStats& loco) {
         if (glm::length(motion.position - ai.target_position) < Globals::ai_distance_epsilon) {
             update_patrol_target_position(ai);
         }
         glm::vec2 dir = Common::normalize(ai.target_position - motion.position);
-        motion.velocity = registry.locomotion_stats.get(e).movement_speed * dir;
+        motion.velocity = loco.movement_speed * dir;
     }
 
-    inline void AI_chase_step(Entity& e) {
+    inline void AI_chase_step(Entity& e, Motion& motion, AIComponent& ai, LocomotionStats& loco) {
         Registry& registry = MapManager::get_instance().get_active_registry();
-        Motion& motion = registry.motions.get(e);
-        AIComponent& ai = registry.ais.get(e);
         update_chasing_target_position(ai);
 
         glm::vec2 ai_position = get_grid_map_coordinates(motion);
@@ -190,10 +154,10 @@ namespace AISystem
         glm::vec2 new_position = get_position_from_grid_map_coordinates(next_position.x, next_position.y);
 
         glm::vec2 dir = Common::normalize(new_position - motion.position);
-        motion.velocity = registry.locomotion_stats.get(e).movement_speed * dir;
+        motion.velocity = loco.movement_speed * dir;
     }
 
-    inline void AI_attack_step(Entity& e) {
+    inline void AI_attack_step(Entity& e, Motion& motion) {
         std::random_device rd;
         std::mt19937 gen(rd());
         std::uniform_int_distribution<> attack_dodge_dist(1, 50);
@@ -204,7 +168,6 @@ namespace AISystem
         }
 
         Registry& registry = MapManager::get_instance().get_active_registry();
-        Motion& motion = registry.motions.get(e);
         Attacker& attacker = registry.attackers.get(e);
 
         glm::vec2 player_position = registry.motions.get(registry.player).position;
@@ -217,10 +180,8 @@ namespace AISystem
         GameplaySystem::attack(e);
     }
 
-    inline void AI_change_state(Entity& e) {
+    inline void AI_change_state(Motion& motion, AIComponent& ai) {
         Registry& registry = MapManager::get_instance().get_active_registry();
-        Motion& motion = registry.motions.get(e);
-        AIComponent& ai = registry.ais.get(e);
         glm::vec2 player_position = registry.motions.get(registry.player).position;
         if (glm::length(motion.position - player_position) < 20.0f) {
             ai.current_state = AI_STATE::ATTACK;
@@ -234,19 +195,39 @@ namespace AISystem
     inline void AI_step() {
         Registry& registry = MapManager::get_instance().get_active_registry();
 
-        for (Entity& e : registry.near_players.entities) {
-            if (registry.ais.has(e) && !registry.death_cooldowns.has(e) && !registry.stagger_cooldowns.has(e)) {
-                AIComponent &ai = registry.ais.get(e);
-                if (ai.current_state == AI_STATE::PATROL) {
-                    AI_patrol_step(e);
-                } else if (ai.current_state == AI_STATE::CHASE) {
-                    AI_chase_step(e);
-                } else if (ai.current_state == AI_STATE::ATTACK) {
-                    AI_chase_step(e);
-                    AI_attack_step(e);
+        struct Agent {
+            Entity e;
+            AIComponent* ai;
+            Motion* motion;
+            LocomotionStats* loco;
+            bool attacks;
+        };
+        FrameVector<Agent> agents;
+        registry.view<AIComponent, NearPlayer, Motion, LocomotionStats>().exclude<DeathCooldown, StaggerCooldown>().each([&](Entity e, AIComponent& ai, NearPlayer&, Motion& motion, LocomotionStats& loco) {
+            agents.push_back({ e, &ai, &motion, &loco, false });
+        });
+
+        // Steering only writes the agent's own Motion and AIComponent and reads the grid map, so it runs in parallel.
+        // get() must not copy snapshot pages from several threads, hence the unshare first.
+        registry.unshare_components<AIComponent, Motion, LocomotionStats, CollisionBounds>();
+        JobSystem::parallel_for_each_chunk(0, agents.size(), 8, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                Agent& agent = agents[i];
+                if (agent.ai->current_state == AI_STATE::PATROL) {
+                    AI_patrol_step(*agent.motion, *agent.ai, *agent.loco);
+                } else if (agent.ai->current_state == AI_STATE::CHASE) {
+                    AI_chase_step(agent.e, *agent.motion, *agent.ai, *agent.loco);
+                } else if (agent.ai->current_state == AI_STATE::ATTACK) {
+                    AI_chase_step(agent.e, *agent.motion, *agent.ai, *agent.loco);
+                    agent.attacks = true;
                 }
-                AI_change_state(e);
+                AI_change_state(*agent.motion, *agent.ai);
             }
+        });
+
+        // Attacks and dodges emplace components and play sounds, so they follow on this thread in the same order
+        for (Agent& agent : agents) {
+            if (agent.attacks) AI_attack_step(agent.e, *agent.motion);
         }
     }
 
@@ -258,14 +239,15 @@ namespace AISystem
         std::mt19937 gen(rd());
         std::uniform_real_distribution<float> dodge_dist(0.0f, 1.0f);
 
-        for (Entity& e : registry.projectiles.entities) {
-            if (glm::distance(registry.motions.get(e).position, registry.motions.get(boss_entity).position) < 4.0f &&
-                registry.teams.get(e).team_id == TEAM_ID::FRIENDLY) {
-                if (dodge_dist(gen) <= dodge_ratio) {
-                    GameplaySystem::dodge(boss_entity);
-                    return;
-                }
-            }
+        // Every friendly projectile within reach gets a chance to make the boss dodge
+        bool dodges = false;
+        CollisionSystem::overlap_circle(registry.motions.get(boss_entity).position, 4.0f, CollisionSystem::QueryScope::Moving, [&](Entity e) {
+            return registry.projectiles.has(e) && registry.teams.get(e).team_id == TEAM_ID::FRIENDLY;
+        }, [&](Entity) {
+            if (!dodges && dodge_dist(gen) <= dodge_ratio) dodges = true;
+        });
+        if (dodges) {
+            GameplaySystem::dodge(boss_entity);
         }
     }
 
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "../components/PhysicsComponents.hpp"
+
+#include <glm/vec2.hpp>
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+// SSE2 is part of every x64 target, and of x86 builds with /arch:SSE2 or -msse2
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COLLISION_KERNELS_SSE2 1
+#include <emmintrin.h>
+#else
+#define COLLISION_KERNELS_SSE2 0
+#endif
+
+// Struct-of-arrays batch of circle pairs for the narrow phase. CollisionSystem::check_collisions gathers the
+// circle-circle candidates of a chunk into it and tests them all at once; Vector is std::vector<float> or a
+// FrameVector<float> for scratch batches.
+template <typename Vector = std::vector<float>>
+struct CirclePairBatch {
+    Vector a_x, a_y;
+    Vector b_x, b_y;
+    Vector radius_sum;
+
+    size_t size() const {
+        return radius_sum.size();
+    }
+
+    // Keeps the capacity for the next batch
+    void clear() {
+        a_x.clear(); a_y.clear();
+        b_x.clear(); b_y.clear();
+        radius_sum.clear();
+    }
+
+    void push_back(const glm::vec2& a, float radius_a, const glm::vec2& b, float radius_b) {
+        a_x.push_back(a.x); a_y.push_back(a.y);
+        b_x.push_back(b.x); b_y.push_back(b.y);
+        radius_sum.push_back(radius_a + radius_b);
+    }
+};
+
+// Hit masks are bit sets, bit i % 32 of word i / 32 is set if pair or segment i overlaps
+namespace CollisionKernels {
+    inline size_t mask_words(size_t count) {
+        return (count + 31) / 32;
+    }
+
+    inline bool is_hit(const uint32_t* masks, size_t i) {
+        return (masks[i / 32] >> (i % 32)) & 1u;
+    }
+
+    // Circles overlap if their centres are closer than the sum of the radii, compared squared so there is no sqrt.
+    // masks must hold mask_words(end) words, the bits of [begin, end) are set or cleared.
+    template <typename Batch>
+    inline void circle_circle_scalar(const Batch& pairs, size_t begin, size_t end, uint32_t* masks) {
+        for (size_t i = begin; i < end; i++) {
+            const float dx = pairs.a_x[i] - pairs.b_x[i];
+            const float dy = pairs.a_y[i] - pairs.b_y[i];
+            const float radius_sum = pairs.radius_sum[i];
+            const uint32_t bit = 1u << (i % 32);
+            if (dx * dx + dy * dy < radius_sum * radius_sum) {
+                masks[i / 32] |= bit;
+            } else {
+                masks[i / 32] &= ~bit;
+            }
+        }
+    }
+
+#if COLLISION_KERNELS_SSE2
+    // Four pairs per iteration, the compare mask of each group becomes four bits of the hit mask
+    template <typename Batch>
+    inline void circle_circle_sse2(const Batch& pairs, uint32_t* masks) {
+        const size_t count = pairs.size();
+        const size_t simd_end = count - count % 4;
+        for (size_t word = 0; word < mask_words(simd_end); word++) masks[word] = 0;
+
+        for (size_t i = 0; i < simd_end; i += 4) {
+            __m128 dx = _mm_sub_ps(_mm_loadu_ps(&pairs.a_x[i]), _mm_loadu_ps(&pairs.b_x[i]));
+            __m128 dy = _mm_sub_ps(_mm_loadu_ps(&pairs.a_y[i]), _mm_loadu_ps(&pairs.b_y[i]));
+            __m128 radius_sum = _mm_loadu_ps(&pairs.radius_sum[i]);
+            __m128 distance_sq = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+            __m128 hit = _mm_cmplt_ps(distance_sq, _mm_mul_ps(radius_sum, radius_sum));
+            masks[i / 32] |= uint32_t(_mm_movemask_ps(hit)) << (i % 32);
+        }
+        circle_circle_scalar(pairs, simd_end, count, masks);
+    }
+#endif
+
+    // Tests every pair of the batch, with SSE2 where the target has it. masks must hold mask_words(pairs.size()) words.
+    template <typename Batch>
+    inline void circle_circle(const Batch& pairs, uint32_t* masks) {
+#if COLLISION_KERNELS_SSE2
+        circle_circle_sse2(pairs, masks);
+#else
+        circle_circle_scalar(pairs, 0, pairs.size(), masks);
+#endif
+    }
+
+    // Whether the circle overlaps the segment: the squared distance to the closest point of the segment is below the
+    // squared radius. Computed in the segment's space, like the SSE2 kernel. Degenerate segments never overlap,
+    // as in CollisionSystem::check_circle_segment.
+    inline bool circle_segment_scalar(const glm::vec2& center, float radius, const LineSegment& segment, const glm::vec2& offset) {
+        const float dir_x = segment.end.x - segment.start.x;
+        const float dir_y = segment.end.y - segment.start.y;
+        const float length_sq = dir_x * dir_x + dir_y * dir_y;
+        if (length_sq < 0.0001f * 0.0001f) return false;
+
+        const float to_x = (center.x - offset.x) - segment.start.x;
+        const float to_y = (center.y - offset.y) - segment.start.y;
+        float t = (to_x * dir_x + to_y * dir_y) / length_sq;
+        t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+        const float dx = to_x - dir_x * t;
+        const float dy = to_y - dir_y * t;
+        return dx * dx + dy * dy < radius * radius;
+    }
+
+    // Hit mask of the circle against up to 32 segments, shifted by offset into world space
+    inline uint32_t circle_segments(const glm::vec2& center, float radius, const LineSegment* segments, size_t count, const glm::vec2& offset) {
+        assert(count <= 32 && "A hit mask holds 32 segments");
+        uint32_t mask = 0;
+        size_t i = 0;
+#if COLLISION_KERNELS_SSE2
+        // The segments are stored as structs, so each group of four is transposed into registers first
+        const __m128 center_x = _mm_set1_ps(center.x - offset.x);
+        const __m128 center_y = _mm_set1_ps(center.y - offset.y);
+        const __m128 radius_sq = _mm_set1_ps(radius * radius);
+        const __m128 min_length_sq = _mm_set1_ps(0.0001f * 0.0001f);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        for (; i + 4 <= count; i += 4) {
+            const LineSegment* s = segments + i;
+            __m128 start_x = _mm_set_ps(s[3].start.x, s[2].start.x, s[1].start.x, s[0].start.x);
+            __m128 start_y = _mm_set_ps(s[3].start.y, s[2].start.y, s[1].start.y, s[0].start.y);
+            __m128 dir_x = _mm_sub_ps(_mm_set_ps(s[3].end.x, s[2].end.x, s[1].end.x, s[0].end.x), start_x);
+            __m128 dir_y = _mm_sub_ps(_mm_set_ps(s[3].end.y, s[2].end.y, s[1].end.y, s[0].end.y), start_y);
+            __m128 length_sq = _mm_add_ps(_mm_mul_ps(dir_x, dir_x), _mm_mul_ps(dir_y, dir_y));
+            __m128 valid = _mm_cmpge_ps(length_sq, min_length_sq);
+
+            __m128 to_x = _mm_sub_ps(center_x, start_x);
+            __m128 to_y = _mm_sub_ps(center_y, start_y);
+            // Degenerate lanes divide by zero, their result is masked out by valid
+            __m128 t = _mm_div_ps(_mm_add_ps(_mm_mul_ps(to_x, dir_x), _mm_mul_ps(to_y, dir_y)), length_sq);
+            t = _mm_min_ps(_mm_max_ps(t, zero), one);
+            __m128 dx = _mm_sub_ps(to_x, _mm_mul_ps(dir_x, t));
+            __m128 dy = _mm_sub_ps(to_y, _mm_mul_ps(dir_y, t));
+            __m128 hit = _mm_and_ps(valid, _mm_cmplt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), radius_sq));
+            mask |= uint32_t(_mm_movemask_ps(hit)) << i;
+        }
+#endif
+        for (; i < count; i++) {
+            if (circle_segment_scalar(center, radius, segments[i], offset)) mask |= 1u << i;
+        }
+        return mask;
+    }
+}
@@ -3,404 +3,200 @@
 #include "../ecs/Entity.hpp"
 #include "../components/Components.hpp"
 #include "../ecs/Registry.hpp"
+#include <algorithm>
 #include <vector>
 #include <glm/geometric.hpp>
 #include "AISystem.hpp"
+#include "CollisionKernels.hpp"
+#include "CollisionWorld.hpp"
 #include "utils/Log.hpp"
+#include "utils/JobSystem.hpp"
+#include "utils/FrameArena.hpp"
 
 namespace CollisionSystem {
     /**
-     * Spatial grid constants and data structures for collision optimization
-     * Grid divides world into cells of CELL_SIZE x CELL_SIZE
-     * Each cell contains references to entities within that space
+     * One overlapping pair found by check_collisions, each pair is found once
+     * Moving a along normal by penetration separates the two, so the normal points from b towards a.
+     * Swept contacts of a ContinuousCollision entity are at their first touch, with no penetration.
      */
-    static constexpr float CELL_SIZE = 10.0f;
-
-    struct Cell {
-        std::vector<Entity*> entities;
+    struct Contact {
+        Entity a;
+        Entity b;
+        glm::vec2 normal;
+        float penetration;
+        float time; // fraction of the step at the first touch, 1 for overlaps found at the end of the step
     };
 
-    // Grid storage: Maps cell coordinates to cells containing entities
-    static std::unordered_map<int, std::unordered_map<int, Cell>> spatial_grid;
-
-    /**
-     * Clears all entities from the spatial grid
-     * Called at the start of each collision detection phase
-     */
-    inline void clear_grid() {
-        spatial_grid.clear();
-    }
-
     /**
-     * Inserts an entity into the spatial grid based on its position
-     * @param entity Pointer to the entity to insert
-     * @param pos World position of the entity
+     * The contacts of the current frame, filled by check_collisions and consumed by handle_collisions
+     * Cleared, not freed, so a steady frame does not allocate. One list for all translation units, like broad_phase().
      */
-    inline void insert_to_grid(Entity* entity, const glm::vec2& pos) {
-        int cell_x = static_cast<int>(std::floor(pos.x / CELL_SIZE));
-        int cell_y = static_cast<int>(std::floor(pos.y / CELL_SIZE));
-        spatial_grid[cell_x][cell_y].entities.push_back(entity);
-    }
-
-    /**
-     * Retrieves all entities near a given position within a radius
-     * Used for broad-phase collision detection
-     * @param pos Center position to check around
-     * @param radius Radius to check within
-     * @return Vector of pointers to nearby entities
-     */
-    inline std::vector<Entity*> get_nearby_entities(const glm::vec2& pos, float radius) {
-        std::vector<Entity*> nearby;
-        // Calculate grid cell coordinates for the given position
-        int center_x = static_cast<int>(std::floor(pos.x / CELL_SIZE));
-        int center_y = static_cast<int>(std::floor(pos.y / CELL_SIZE));
-
-        // Calculate how many cells we need to check based on radius
-        int cell_radius = static_cast<int>(std::ceil(radius / CELL_SIZE));
-
-        // Check all cells within the calculated range
-        for (int x = center_x - cell_radius; x <= center_x + cell_radius; x++) {
-            for (int y = center_y - cell_radius; y <= center_y + cell_radius; y++) {
-                auto& cell = spatial_grid[x][y];
-                nearby.insert(nearby.end(), cell.entities.begin(), cell.entities.end());
-            }
-        }
-        return nearby;
-    }
-
-    /**
-     * Checks collision between two circles using distance-based detection
-     * @param c1 First circle collider
-     * @param pos1 Position of first circle
-     * @param c2 Second circle collider
-     * @param pos2 Position of second circle
-     * @return true if circles overlap
-     */
-    inline bool check_circle_circle(
-        const CircleCollider& c1, const glm::vec2& pos1,
-        const CircleCollider& c2, const glm::vec2& pos2
-    ) {
-        float distance = glm::length(pos2 - pos1);
-        return distance < (c1.radius + c2.radius);
-    }
-
-    /**
-     * Helper function to check collision between a circle and a line segment
-     * Handles both edge and corner collisions for walls
-     * @param circle Circle collider to check
-     * @param circle_pos Position of circle
-     * @param segment Line segment to check against
-     * @param offset World space offset for the segment
-     * @param out_normal Output parameter for collision normal
-     * @param out_penetration Output parameter for penetration depth
-     * @return true if collision detected
-     */
-    inline bool check_circle_segment(
-        const CircleCollider& circle, const glm::vec2& circle_pos,
-        const LineSegment& segment, const glm::vec2& offset,
-        glm::vec2& out_normal, float& out_penetration
-    ) {
-        // Transform segment to world space
-        glm::vec2 start = segment.start + offset;
-        glm::vec2 end = segment.end + offset;
-
-        // Calculate segment vector
-        glm::vec2 segment_vec = end - start;
-        float segment_length = glm::length(segment_vec);
-
-        if (segment_length < 0.0001f) return false;  // Degenerate segment
-
-        // Project circle center onto segment line
-        glm::vec2 to_circle = circle_pos - start;
-        float proj = glm::dot(to_circle, segment_vec) / segment_length;
-
-        // Find closest point on segment to circle
-        glm::vec2 closest;
-        if (proj <= 0.0f) {
-            closest = start;  // Circle is beyond segment start
-        } else if (proj >= segment_length) {
-            closest = end;    // Circle is beyond segment end
-        } else {
-            closest = start + (segment_vec * proj / segment_length);  // Circle projects onto segment
-        }
-
-        // Check for overlap
-        glm::vec2 to_closest = circle_pos - closest;
-        float dist = glm::length(to_closest);
-
-        if (dist < circle.radius) {
-            // Use segment normal if circle center is exactly on segment
-            out_normal = dist > 0.0001f ? to_closest / dist : segment.normal;
-            out_penetration = circle.radius - dist;
-            return true;
-        }
-
-        return false;
-    }
-
-    /**
-     * Checks collision between a circle and a wall
-     * Uses broad-phase AABB check followed by detailed edge checks
-     * @param circle Circle collider
-     * @param circle_pos Circle position
-     * @param wall Wall collider
-     * @param wall_pos Wall position
-     * @param out_normal Output parameter for collision normal
-     * @param out_penetration Output parameter for penetration depth
-     * @return true if collision detected
-     */
-    inline bool check_circle_wall(
-        const CircleCollider& circle, const glm::vec2& circle_pos,
-        const WallCollider& wall, const glm::vec2& wall_pos,
-        glm::vec2& out_normal, float& out_penetration
-    ) {
-        // Broad phase using AABB
-        glm::vec2 closest = glm::max(
-            wall.aabb.min + wall_pos,
-            glm::min(circle_pos, wall.aabb.max + wall_pos)
-        );
-        if (glm::length(circle_pos - closest) > circle.radius) {
-            return false;  // No collision possible
-        }
-
-        // Detailed phase: check each edge
-        bool collision = false;
-        float max_penetration = 0.0f;
-        glm::vec2 best_normal(0.0f, 0.0f);
-
-        // Check collision against each edge of the wall
-        for (const auto& edge : wall.edges) {
-            glm::vec2 edge_normal;
-            float edge_penetration;
-
-            if (check_circle_segment(circle, circle_pos, edge, wall_pos,
-                                     edge_normal, edge_penetration)) {
-                collision = true;
-                if (edge_penetration > max_penetration) {
-                    max_penetration = edge_penetration;
-                    best_normal = edge_normal;
-                }
-            }
-        }
-
-        if (collision) {
-            out_normal = best_normal;
-            out_penetration = max_penetration;
-        }
-
-        return collision;
-    }
-
-    /**
-     * Checks collision between a circle and a convex mesh
-     * Uses broad phase with bounding radius followed by detailed edge checks
-     * @param circle Circle collider
-     * @param circle_pos Circle position
-     * @param mesh Mesh collider containing vertices forming a convex hull
-     * @param mesh_pos Mesh position
-     * @return true if collision detected
-     */
-    inline bool check_circle_mesh(
-        const CircleCollider& circle, const glm::vec2& circle_pos,
-        const MeshCollider& mesh, const glm::vec2& mesh_pos
-    ) {
-        // Added logging because hard to debug mesh-based collisions; we can remove later
-        // Log::log_info(std::string("Processing collision between circle and mesh (") + 
-        //               std::to_string(mesh.vertices.size()) + " vertices)", 
-        //               __FILE__, __LINE__);
-
-        // Broad phase using bounding radius
-        if (glm::length(mesh_pos - circle_pos) > (circle.radius + mesh.bound_radius)) {
-            return false;
-        }
-
-        // Narrow phase: Check each edge of the mesh
-        for (size_t i = 0; i < mesh.vertices.size(); i++) {
-            const glm::vec2& v1 = mesh.vertices[i] + mesh_pos;
-            const glm::vec2& v2 = mesh.vertices[(i + 1) % mesh.vertices.size()] + mesh_pos;
-
-            // Create temporary segment for collision check
-            LineSegment segment{
-                v1 - mesh_pos,
-                v2 - mesh_pos,
-                glm::normalize(glm::vec2(-(v2.y - v1.y), v2.x - v1.x))  // Perpendicular normal
-            };
-
-            glm::vec2 normal;
-            float penetration;
-            if (check_circle_segment(circle, circle_pos, segment, mesh_pos, normal, penetration)) {
-                return true;
-            }
-        }
-        return false;
+    inline std::vector<Contact>& contacts() {
+        static std::vector<Contact> instance;
+        return instance;
     }
 
     /**
      * Main collision detection loop
-     * Uses spatial partitioning to optimize collision checks
+     * Only moving colliders go through the spatial hash, each of them also queries the static collider BVH with
+     * its bounding box. Static colliders never test against each other.
+     * Every pair is tested once: of two moving colliders the one with the smaller id tests the other, which its query
+     * always finds since it reaches as far as the largest moving collider, and pairs with a static collider are tested
+     * by the moving one. The contacts carry the normal and penetration at detection, handle_collisions measures pushes again.
+     * Entities with ContinuousCollision test their path from the start of the step instead, with sweep_pair against
+     * everything near it; they test all their own pairs. The contacts are handled earliest touch first.
+     * Circle-circle pairs, most of them, are gathered per chunk into a CirclePairBatch and tested four at a time by
+     * CollisionKernels, the rest one by one with test_pair.
+     * The narrow phase runs in parallel over chunks of the colliders, each chunk writes its own contact list. The
+     * lists are merged and sorted by time and entity pair, so the contacts are the same bit for bit with any number of threads,
+     * and do not depend on where the components are stored either (see SpatialSortSystem)
+     * All scratch lists live in the frame arena, so a steady frame does not allocate
      */
     inline void check_collisions() {
         Registry& registry = MapManager::get_instance().get_active_registry();
 
-        // Clear and rebuild spatial grid
-        clear_grid();
+        update_static_colliders(registry);
+        BroadPhase& world = broad_phase();
+        SpatialHash& spatial_hash = world.spatial_hash;
+        const StaticColliders& static_colliders = world.static_colliders;
+
+        // Rebuild the spatial hash of the moving colliders
+        float max_radius = 0.0f;
+        spatial_hash.clear();
+        registry.view<NearPlayer, CollisionBounds, Motion>().exclude<Wall, StaticObject>().each([&](Entity entity, NearPlayer&, CollisionBounds& bounds, Motion& motion) {
+            spatial_hash.insert(entity, motion.position);
+            max_radius = std::max(max_radius, broad_phase_radius(bounds));
+        });
+        spatial_hash.build();
+        world.max_moving_radius = max_radius;
+
+        FrameVector<Entity> colliders;
+        registry.view<NearPlayer, CollisionBounds, Motion, Team>().exclude<DeathCooldown, Wall, StaticObject>().each([&](Entity entity_i, NearPlayer&, CollisionBounds&, Motion&, Team&) {
+            colliders.push_back(entity_i);
+        });
+
+        // Check collisions using the spatial hash and the BVH. get() must not copy snapshot pages from several threads.
+        registry.unshare_components<CollisionBounds, Motion, Team, ContinuousCollision>();
+        const size_t MIN_CHUNK = 16;
+        const size_t chunk_count = (colliders.size() + MIN_CHUNK - 1) / MIN_CHUNK;
+        FrameVector<FrameVector<Contact>> chunk_contacts(chunk_count);
+        JobSystem::parallel_for_each_chunk(0, chunk_count, 1, [&](size_t chunk_begin, size_t chunk_end) {
+            // Circle pairs of a chunk are only gathered while walking the candidates and tested together at the end
+            CirclePairBatch<FrameVector<float>> circle_pairs;
+            FrameVector<std::pair<Entity, Entity>> circle_entities;
+            FrameVector<uint32_t> hits;
+            for (size_t chunk = chunk_begin; chunk < chunk_end; chunk++) {
+                FrameVector<Contact>& found = chunk_contacts[chunk];
+                circle_pairs.clear();
+                circle_entities.clear();
+                const size_t end = std::min(colliders.size(), (chunk + 1) * MIN_CHUNK);
+                for (size_t i = chunk * MIN_CHUNK; i < end; i++) {
+                    Entity entity_i = colliders[i];
+                    const CollisionBounds& bounds_i = registry.collision_bounds.get(entity_i);
+                    const Motion& motion_i = registry.motions.get(entity_i);
+                    const Team& team_i = registry.teams.get(entity_i);
+
+                    Contact contact{ Entity::null(), Entity::null(), glm::vec2(0.0f), 0.0f, 1.0f }; // Entity() would create an entity
+                    auto test = [&](Entity entity_j) {
+                        const CollisionBounds& bounds_j = registry.collision_bounds.get(entity_j);
+                        const Motion& motion_j = registry.motions.get(entity_j);
+                        if (bounds_i.type == ColliderType::Circle && bounds_j.type == ColliderType::Circle) {
+                            circle_pairs.push_back(motion_i.position, bounds_i.circle.radius, motion_j.position, bounds_j.circle.radius);
+                            circle_entities.push_back({ entity_i, entity_j });
+                        } else if (test_pair(bounds_i, motion_i, bounds_j, motion_j, contact.normal, contact.penetration)) {
+                            contact.a = entity_i;
+                            contact.b = entity_j;
+                            found.push_back(contact);
+                        }
+                    };
+
+                    if (const ContinuousCollision* continuous = registry.continuous_collisions.try_get(entity_i)) {
+                        // A fast collider tests the whole path of its step instead of where it ended up
+                        const glm::vec2 start = continuous->start;
+                        auto sweep = [&](Entity entity_j) {
+                            const CollisionBounds& bounds_j = registry.collision_bounds.get(entity_j);
+                            const Motion& motion_j = registry.motions.get(entity_j);
+                            if (sweep_pair(bounds_i, start, motion_i.position, bounds_j, motion_j, contact.time, contact.normal)) {
+                                contact.a = entity_i;
+                                contact.b = entity_j;
+                                found.push_back(contact);
+                            }
+                        };
 
-        // Insert entities into spatial grid
-        for (auto& entity : registry.near_players.entities) {
-            if (!registry.collision_bounds.has(entity)) continue;
-            const auto& motion = registry.motions.get(entity);
-            insert_to_grid(&entity, motion.position);
-        }
+                        const glm::vec2 half_path = (motion_i.position - start) * 0.5f;
+                        const float radius_i = broad_phase_radius(bounds_i);
+                        for (Entity entity_j : spatial_hash.query(start + half_path, glm::length(half_path) + radius_i + max_radius)) {
+                            // Two fast colliders are tested by the one with the smaller id, a slow one never tests a fast one
+                            if (entity_i.get_id() == entity_j.get_id()) continue;
+                            if (entity_i.get_id() > entity_j.get_id() && registry.continuous_collisions.has(entity_j)) continue;
 
-        // Check collisions using spatial grid
-        for (auto& entity_i : registry.near_players.entities) {
-            if (!registry.collision_bounds.has(entity_i) || registry.death_cooldowns.has(entity_i)) continue;
-
-            const auto& bounds_i = registry.collision_bounds.get(entity_i);
-            const auto& motion_i = registry.motions.get(entity_i);
-
-            // Determine radius for broad phase
-            float check_radius = 0.0f;
-            if (bounds_i.type == ColliderType::Circle) {
-                check_radius = bounds_i.circle.radius;
-            } else if (bounds_i.type == ColliderType::Wall) {
-                // Use half diagonal of AABB for walls
-                glm::vec2 half_size = (bounds_i.wall->aabb.max - bounds_i.wall->aabb.min) * 0.5f;
-                check_radius = glm::length(half_size);
-            } else if (bounds_i.type == ColliderType::Mesh) {
-                check_radius = bounds_i.mesh->bound_radius;
-            }
+                            if (registry.death_cooldowns.has(entity_j)) continue;
+                            if (team_i.team_id == registry.teams.get(entity_j).team_id) continue;
 
-            // Get potentially colliding entities from spatial grid
-            auto nearby = get_nearby_entities(motion_i.position, check_radius + CELL_SIZE);
+                            sweep(entity_j);
+                        }
 
-            // Check collision with each nearby entity
-            for (auto* entity_j_ptr : nearby) {
-                Entity& entity_j = *entity_j_ptr;
-                if (&entity_i == &entity_j) continue;
+                        // Static colliders overlapping the box around the path
+                        static_colliders.bvh.query(glm::min(start, motion_i.position) - radius_i, glm::max(start, motion_i.position) + radius_i, [&](Entity entity_s) {
+                            if (registry.death_cooldowns.has(entity_s)) return;
+                            if (team_i.team_id == registry.teams.get(entity_s).team_id) return;
 
-                if (!registry.collision_bounds.has(entity_j) || registry.death_cooldowns.has(entity_j)) continue;
+                            sweep(entity_s);
+                        });
+                        continue;
+                    }
 
-                const auto& bounds_j = registry.collision_bounds.get(entity_j);
-                const auto& motion_j = registry.motions.get(entity_j);
+                    // Check collision with each potentially colliding entity from the spatial hash
+                    for (Entity entity_j : spatial_hash.query(motion_i.position, broad_phase_radius(bounds_i) + max_radius)) {
+                        // The collider with the smaller id tests the pair, a fast collider tests its own pairs
+                        if (entity_i.get_id() >= entity_j.get_id()) continue;
+                        if (registry.continuous_collisions.has(entity_j)) continue;
 
-                // Skip collision check if entities are on the same team
-                if (registry.teams.get(entity_i).team_id ==
-                    registry.teams.get(entity_j).team_id) {
-                    continue;
-                }
+                        if (registry.death_cooldowns.has(entity_j)) continue;
 
-                bool collision = false;
-                glm::vec2 normal;
-                float penetration;
-
-                // Handle all possible collider type combinations
-                if (bounds_i.type == ColliderType::Circle) {
-                    switch (bounds_j.type) {
-                        case ColliderType::Circle:
-                            collision = check_circle_circle(
-                                bounds_i.circle, motion_i.position,
-                                bounds_j.circle, motion_j.position
-                            );
-                            break;
-
-                        case ColliderType::Wall:
-                            collision = check_circle_wall(
-                                bounds_i.circle, motion_i.position,
-                                *bounds_j.wall, motion_j.position,
-                                normal, penetration
-                            );
-                            break;
-
-                        case ColliderType::Mesh:
-                            collision = check_circle_mesh(
-                                bounds_i.circle, motion_i.position,
-                                *bounds_j.mesh, motion_j.position
-                            );
-                            break;
-                        case ColliderType::AABB:
-                            // Handle AABB collision or log warning
-                            break;
-                    }
-                }
-                // Handle reverse cases (when first entity is not a circle)
-                else if (bounds_j.type == ColliderType::Circle) {
-                    switch (bounds_i.type) {
-                        case ColliderType::Wall:
-                            collision = check_circle_wall(
-                                bounds_j.circle, motion_j.position,
-                                *bounds_i.wall, motion_i.position,
-                                normal, penetration
-                            );
-                            normal = -normal;  // Reverse normal for correct response
-                            break;
-
-                        case ColliderType::Mesh:
-                            collision = check_circle_mesh(
-                                bounds_j.circle, motion_j.position,
-                                *bounds_i.mesh, motion_i.position
-                            );
-                            break;
-                        case ColliderType::Circle:
-                        case ColliderType::AABB:
-                            // Handle or log warning
-                            break;
-                    }
-                }
-                else if (bounds_i.type == ColliderType::Mesh) {
-                    switch (bounds_j.type) {
-                        case ColliderType::Wall:
-                            {
-                                CircleCollider temp_circle{bounds_i.mesh->bound_radius};
-                                collision = check_circle_wall(
-                                    temp_circle, motion_i.position,
-                                    *bounds_j.wall, motion_j.position,
-                                    normal, penetration
-                                );
-                            }
-                            break;
-                        case ColliderType::Circle:
-                            // Already handled in Circle section
-                            break;
-                        case ColliderType::Mesh:
-                            // Mesh-mesh collision if needed
-                            break;
-                        case ColliderType::AABB:
-                            // Handle AABB collision or log warning
-                            break;
-                    }
-                }
-                else if (bounds_i.type == ColliderType::Wall) {
-                    switch (bounds_j.type) {
-                        case ColliderType::Mesh:
-                            {
-                                CircleCollider temp_circle{bounds_j.mesh->bound_radius};
-                                collision = check_circle_wall(
-                                    temp_circle, motion_j.position,
-                                    *bounds_i.wall, motion_i.position,
-                                    normal, penetration
-                                );
-                                normal = -normal;  // Reverse normal for correct response
-                            }
-                            break;
-                        case ColliderType::Circle:
-                            // Already handled in Circle section
-                            break;
-                        case ColliderType::Wall:
-                            // Wall-wall collision if needed
-                            break;
-                        case ColliderType::AABB:
-                            // Handle AABB collision or log warning
-                            break;
+                        // Skip collision check if entities are on the same team
+                        if (team_i.team_id == registry.teams.get(entity_j).team_id) {
+                            continue;
+                        }
+
+                        test(entity_j);
                     }
+
+                    // Static colliders overlapping the bounding box
+                    glm::vec2 aabb_min, aabb_max;
+                    collider_aabb(bounds_i, motion_i, aabb_min, aabb_max);
+                    static_colliders.bvh.query(aabb_min, aabb_max, [&](Entity entity_s) {
+                        if (registry.death_cooldowns.has(entity_s)) return;
+                        if (team_i.team_id == registry.teams.get(entity_s).team_id) return;
+
+                        test(entity_s);
+                    });
                 }
 
-                // Register collision if detected
-                if (collision) {
-                    registry.collisions.emplace_with_duplicates(entity_i, entity_j);
+                // The circle pairs of the chunk, only the hits pay for the sqrt of their contact
+                hits.resize(CollisionKernels::mask_words(circle_pairs.size()));
+                CollisionKernels::circle_circle(circle_pairs, hits.data());
+                for (size_t k = 0; k < circle_pairs.size(); k++) {
+                    if (!CollisionKernels::is_hit(hits.data(), k)) continue;
+                    Contact contact{ circle_entities[k].first, circle_entities[k].second, glm::vec2(0.0f), 0.0f, 1.0f };
+                    circle_circle_contact(circle_pairs.radius_sum[k],
+                                          { circle_pairs.a_x[k], circle_pairs.a_y[k] }, { circle_pairs.b_x[k], circle_pairs.b_y[k] },
+                                          contact.normal, contact.penetration);
+                    found.push_back(contact);
                 }
             }
+        });
+
+        // Merge the chunk lists. Every pair is found once, so (a, b) is a unique key, and earlier touches come first.
+        std::vector<Contact>& merged = contacts();
+        merged.clear();
+        for (auto& found : chunk_contacts) {
+            merged.insert(merged.end(), found.begin(), found.end());
         }
+        std::sort(merged.begin(), merged.end(), [](const Contact& left, const Contact& right) {
+            if (left.time != right.time) return left.time < right.time;
+            return left.a.get_id() != right.a.get_id() ? left.a.get_id() < right.a.get_id() : left.b.get_id() < right.b.get_id();
+        });
     }
 
     /**
@@ -441,7 +237,7 @@ namespace CollisionSystem {
 
         // Remove projectile after hit
         if (projectile.projectile_type == PROJECTILE_TYPE::ARROW) {
-            registry.remove_all_components_of(proj);
+            registry.commands.destroy(proj);
         }
 
         // Handle locomotive entity death if health depleted
@@ -460,6 +256,8 @@ namespace CollisionSystem {
     /**
      * Handles collision between two locomotive entities
      * Pushes entities apart based on collision normal
+     * The overlap is measured again from the current positions, an earlier contact of the frame may already have
+     * moved either of them
      * @param loco1 First locomotive entity
      * @param loco2 Second locomotive entity
      */
@@ -468,41 +266,33 @@ namespace CollisionSystem {
 
         Motion& motion1 = registry.motions.get(loco1);
         Motion& motion2 = registry.motions.get(loco2);
+        glm::vec2 normal;
+        float penetration;
+        if (!test_pair(registry.collision_bounds.get(loco1), motion1, registry.collision_bounds.get(loco2), motion2, normal, penetration)) {
+            return;
+        }
 
-        const auto& bounds1 = registry.collision_bounds.get(loco1);
-        const auto& bounds2 = registry.collision_bounds.get(loco2);
-
-        // Calculate separation vector
-        glm::vec2 delta = motion1.position - motion2.position;
-        float distance = glm::length(delta);
-
-        if (distance > 0.0001f) {
-            glm::vec2 normal = delta / distance;
-            float combined_radius = bounds1.circle.radius + bounds2.circle.radius;
-            float overlap = combined_radius - distance;
-
-            if (overlap > 0) {
-                // Reduce BUFFER to minimize excessive pushback
-                const float BUFFER = 0.0f;  // Removed additional buffer
-
-                // Equal distribution of overlap to both entities
-                float separation = overlap / 2.0f;
-
-                // Minimal position adjustment to resolve overlap
-                motion1.position += normal * separation;
-                motion2.position -= normal * separation;
-
-                // Minimal velocity adjustment to prevent future overlaps
-                float vel1_along_normal = glm::dot(motion1.velocity, normal);
-                float vel2_along_normal = glm::dot(motion2.velocity, normal);
-
-                if (vel1_along_normal - vel2_along_normal < 0) {
-                    // Very minimal impulse to adjust velocities
-                    const float IMPULSE_FACTOR = 0.01f;  // Further reduced from 0.05f
-                    glm::vec2 impulse = normal * (vel1_along_normal - vel2_along_normal) * IMPULSE_FACTOR;
-                    motion1.velocity -= impulse;
-                    motion2.velocity += impulse;
-                }
+        // A zero normal means the centres coincide and there is no direction to separate them in
+        if (normal != glm::vec2(0.0f) && penetration > 0) {
+            // Equal distribution of overlap to both entities
+            float separation = penetration / 2.0f;
+
+            // Minimal position adjustment to resolve overlap
+            motion1.position += normal * separation;
+            motion2.position -= normal * separation;
+            registry.motions.mark_changed(loco1);
+            registry.motions.mark_changed(loco2);
+
+            // Minimal velocity adjustment to prevent future overlaps
+            float vel1_along_normal = glm::dot(motion1.velocity, normal);
+            float vel2_along_normal = glm::dot(motion2.velocity, normal);
+
+            if (vel1_along_normal - vel2_along_normal < 0) {
+                // Very minimal impulse to adjust velocities
+                const float IMPULSE_FACTOR = 0.01f;  // Further reduced from 0.05f
+                glm::vec2 impulse = normal * (vel1_along_normal - vel2_along_normal) * IMPULSE_FACTOR;
+                motion1.velocity -= impulse;
+                motion2.velocity += impulse;
             }
         }
     }
@@ -515,12 +305,14 @@ namespace CollisionSystem {
      */
     inline void proj_fixed_collision(Entity& proj, Entity& fixed) {
         Registry& registry = MapManager::get_instance().get_active_registry();
-        registry.remove_all_components_of(proj);
+        registry.commands.destroy(proj);
     }
 
     /**
      * Handles collision between a locomotive entity and a fixed entity
      * Implements detailed collision response for walls and other fixed objects
+     * The overlap is measured again from the current position, so wall runs overlapping at a corner or several trees
+     * touched in one frame do not push the entity out more than once
      * @param loco Locomotive entity
      * @param fixed Fixed entity
      */
@@ -538,48 +330,38 @@ namespace CollisionSystem {
 
         const float BASE_BUFFER = 0.05f;
 
-        if (fixed_bounds.type == ColliderType::Wall) {
-            // Handle wall collision
-            glm::vec2 normal;
-            float penetration;
-
-            if (check_circle_wall(loco_bounds.circle, loco_motion.position,
-                                *fixed_bounds.wall, fixed_motion.position,
-                                normal, penetration)) {
-                // Simple position correction
-                loco_motion.position += normal * penetration;
-
-                // Simplified velocity response
-                float vel_along_normal = glm::dot(loco_motion.velocity, normal);
-                if (vel_along_normal < 0) {
-                    // Just cancel out the velocity towards the wall
-                    loco_motion.velocity -= normal * vel_along_normal;
-
-                    // Apply minimal wall friction
-                    glm::vec2 tangent(-normal.y, normal.x);
-                    float vel_along_tangent = glm::dot(loco_motion.velocity, tangent);
-                    const float WALL_FRICTION = 0.95f;  // High friction for stability
-                    loco_motion.velocity = tangent * vel_along_tangent * WALL_FRICTION;
-                }
+        // No longer overlapping if an earlier contact already pushed the loco clear
+        glm::vec2 normal;
+        float penetration;
+        bool overlapping = test_pair(loco_bounds, loco_motion, fixed_bounds, fixed_motion, normal, penetration);
+
+        if (overlapping && fixed_bounds.type == ColliderType::Wall) {
+            // Simple position correction
+            loco_motion.position += normal * penetration;
+            registry.motions.mark_changed(loco);
+
+            // Simplified velocity response
+            float vel_along_normal = glm::dot(loco_motion.velocity, normal);
+            if (vel_along_normal < 0) {
+                // Just cancel out the velocity towards the wall
+                loco_motion.velocity -= normal * vel_along_normal;
+
+                // Apply minimal wall friction
+                glm::vec2 tangent(-normal.y, normal.x);
+                float vel_along_tangent = glm::dot(loco_motion.velocity, tangent);
+                const float WALL_FRICTION = 0.95f;  // High friction for stability
+                loco_motion.velocity = tangent * vel_along_tangent * WALL_FRICTION;
             }
-        } else {
+        } else if (overlapping && normal != glm::vec2(0.0f)) {  // Coincident centres give no direction to push in
             // Simple circle-circle collision for fixed objects (trees)
-            glm::vec2 delta = loco_motion.position - fixed_motion.position;
-            float dist = glm::length(delta);
-
-            if (dist > 0.0001f) {  // Prevent division by zero
-                float combined_radius = loco_bounds.circle.radius + fixed_bounds.circle.radius;
-                if (dist < combined_radius) {  // Collision detected
-                    // Normalize and apply correction
-                    glm::vec2 normal = delta / dist;
-                    loco_motion.position = fixed_motion.position + normal * (combined_radius + BASE_BUFFER);
-                    
-                    // Zero out velocity toward the fixed object
-                    float vel_along_normal = glm::dot(loco_motion.velocity, normal);
-                    if (vel_along_normal < 0) {
-                        loco_motion.velocity -= normal * vel_along_normal;
-                    }
-                }
+            float combined_radius = broad_phase_radius(loco_bounds) + broad_phase_radius(fixed_bounds);
+            loco_motion.position = fixed_motion.position + normal * (combined_radius + BASE_BUFFER);
+            registry.motions.mark_changed(loco);
+
+            // Zero out velocity toward the fixed object
+            float vel_along_normal = glm::dot(loco_motion.velocity, normal);
+            if (vel_along_normal < 0) {
+                loco_motion.velocity -= normal * vel_along_normal;
             }
         }
 
@@ -594,56 +376,50 @@ namespace CollisionSystem {
 
     /**
      * Main collision handling function
-     * Processes all detected collisions and applies appropriate responses
-     * Priority order: fixed collisions first, then other collisions
+     * Resolves the contacts of check_collisions in their sorted order. Pushes between locos and fixed entities measure
+     * the overlap again, since earlier contacts may have moved them since detection.
      */
     inline void handle_collisions() {
         Registry& registry = MapManager::get_instance().get_active_registry();
 
-        // Create a separate vector to store collisions
-        std::vector<std::pair<Entity, Entity>> collision_pairs;
-        for (unsigned int i = 0; i < registry.collisions.entities.size(); i++) {
-            Entity& entity1 = registry.collisions.entities[i];
-            Entity& entity2 = registry.collisions.get(entity1).other;
-            collision_pairs.emplace_back(entity1, entity2);
-        }
-
-        // Clear the original collisions vector
-        registry.collisions.clear();
-
-        // Process each collision pair
-        for (auto& pair : collision_pairs) {
-            Entity& entity1 = pair.first;
-            Entity& entity2 = pair.second;
+        for (Contact& contact : contacts()) {
+            Entity& entity1 = contact.a;
+            Entity& entity2 = contact.b;
 
-            // Check if both entities still exist
-            if (!registry.valid(entity1) || !registry.valid(entity2)) {
+            // Check if both entities still exist and neither was already removed by an earlier pair
+            if (!registry.valid(entity1) || !registry.valid(entity2)
+                || registry.commands.is_destroy_pending(entity1) || registry.commands.is_destroy_pending(entity2)) {
                 continue;
             }
 
             // Determine collision type and call appropriate handler
-            if (registry.projectiles.has(entity1)) {
-                if (registry.locomotion_stats.has(entity2)) {
+            bool is_proj1 = registry.has<Projectile>(entity1);
+            bool is_loco1 = registry.has<LocomotionStats>(entity1);
+            bool is_proj2 = registry.has<Projectile>(entity2);
+            bool is_loco2 = registry.has<LocomotionStats>(entity2);
+            if (is_proj1) {
+                if (is_loco2) {
                     proj_loco_collision(entity1, entity2);
                 } else {
                     proj_fixed_collision(entity1, entity2);
                 }
-            } else if (registry.locomotion_stats.has(entity1)) {
-                if (registry.projectiles.has(entity2)) {
+            } else if (is_loco1) {
+                if (is_proj2) {
                     proj_loco_collision(entity2, entity1);
-                } else if (registry.locomotion_stats.has(entity2)) {
+                } else if (is_loco2) {
                     loco_loco_collision(entity1, entity2);
                 } else {
                     loco_fixed_collision(entity1, entity2);
                 }
             } else {
-                if (registry.projectiles.has(entity2)) {
+                if (is_proj2) {
                     proj_fixed_collision(entity2, entity1);
-                } else if (registry.locomotion_stats.has(entity2)) {
+                } else if (is_loco2) {
                     loco_fixed_collision(entity2, entity1);
                 }
             }
         }
+        contacts().clear();
     }
 
 } // namespace CollisionSystem
\ No newline at end of file
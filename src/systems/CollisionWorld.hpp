@@ -0,0 +1,846 @@
+#pragma once
+
+#include "../ecs/Entity.hpp"
+#include "../components/Components.hpp"
+#include "../ecs/Registry.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <glm/geometric.hpp>
+#include "app/MapManager.hpp"
+#include "CollisionKernels.hpp"
+#include "utils/SpatialHash.hpp"
+#include "utils/StaticBVH.hpp"
+
+// The collision world: the broad phase structures, the shape tests of the narrow phase and queries against both.
+// CollisionSystem builds the broad phase and resolves contacts; AI and gameplay code only query, so they include
+// this header instead of CollisionSystem.hpp, which depends on them.
+namespace CollisionSystem {
+    /**
+     * Spatial hash constants for collision optimization
+     * The hash divides the world into cells of CELL_SIZE x CELL_SIZE and is rebuilt at the start of each
+     * collision detection phase, reusing the memory of the previous frame
+     */
+    static constexpr float CELL_SIZE = 10.0f;
+
+    /**
+     * Walls and static objects never move, so they are kept out of the spatial hash in a BVH that is only rebuilt
+     * when the active registry changes or a static collider is added or removed
+     */
+    struct StaticColliders {
+        StaticBVH bvh;
+        unsigned int registry_id = 0; // Registry::id() of the registry the BVH was built from
+        ChangeVersion version = 0;    // the change version at the build
+    };
+
+    /**
+     * Broad phase storage, filled by check_collisions and read by it and the queries
+     */
+    struct BroadPhase {
+        SpatialHash spatial_hash{ CELL_SIZE }; // moving colliders at their positions in the last check_collisions
+        StaticColliders static_colliders;
+        float max_moving_radius = 0.0f;        // largest broad_phase_radius in the spatial hash
+    };
+
+    /**
+     * The broad phase of the program. A function local static, so every translation unit sees the same one.
+     */
+    inline BroadPhase& broad_phase() {
+        static BroadPhase instance;
+        return instance;
+    }
+
+    /**
+     * Checks collision between two circles using distance-based detection
+     * @param c1 First circle collider
+     * @param pos1 Position of first circle
+     * @param c2 Second circle collider
+     * @param pos2 Position of second circle
+     * @return true if circles overlap
+     */
+    inline bool check_circle_circle(
+        const CircleCollider& c1, const glm::vec2& pos1,
+        const CircleCollider& c2, const glm::vec2& pos2
+    ) {
+        // Compared squared, so a miss costs no sqrt
+        glm::vec2 delta = pos2 - pos1;
+        float radius_sum = c1.radius + c2.radius;
+        return glm::dot(delta, delta) < radius_sum * radius_sum;
+    }
+
+    /**
+     * Helper function to check collision between a circle and a line segment
+     * Handles both edge and corner collisions for walls
+     * @param circle Circle collider to check
+     * @param circle_pos Position of circle
+     * @param segment Line segment to check against
+     * @param offset World space offset for the segment
+     * @param out_normal Output parameter for collision normal
+     * @param out_penetration Output parameter for penetration depth
+     * @return true if collision detected
+     */
+    inline bool check_circle_segment(
+        const CircleCollider& circle, const glm::vec2& circle_pos,
+        const LineSegment& segment, const glm::vec2& offset,
+        glm::vec2& out_normal, float& out_penetration
+    ) {
+        // Transform segment to world space
+        glm::vec2 start = segment.start + offset;
+        glm::vec2 end = segment.end + offset;
+
+        // Calculate segment vector
+        glm::vec2 segment_vec = end - start;
+        float segment_length = glm::length(segment_vec);
+
+        if (segment_length < 0.0001f) return false;  // Degenerate segment
+
+        // Project circle center onto segment line
+        glm::vec2 to_circle = circle_pos - start;
+        float proj = glm::dot(to_circle, segment_vec) / segment_length;
+
+        // Find closest point on segment to circle
+        glm::vec2 closest;
+        if (proj <= 0.0f) {
+            closest = start;  // Circle is beyond segment start
+        } else if (proj >= segment_length) {
+            closest = end;    // Circle is beyond segment end
+        } else {
+            closest = start + (segment_vec * proj / segment_length);  // Circle projects onto segment
+        }
+
+        // Check for overlap
+        glm::vec2 to_closest = circle_pos - closest;
+        float dist = glm::length(to_closest);
+
+        if (dist < circle.radius) {
+            // Use segment normal if circle center is exactly on segment
+            out_normal = dist > 0.0001f ? to_closest / dist : segment.normal;
+            out_penetration = circle.radius - dist;
+            return true;
+        }
+
+        return false;
+    }
+
+    /**
+     * Checks collision between a circle and a wall
+     * Uses broad-phase AABB check followed by detailed edge checks
+     * @param circle Circle collider
+     * @param circle_pos Circle position
+     * @param wall Wall collider
+     * @param wall_pos Wall position
+     * @param out_normal Output parameter for collision normal
+     * @param out_penetration Output parameter for penetration depth
+     * @return true if collision detected
+     */
+    inline bool check_circle_wall(
+        const CircleCollider& circle, const glm::vec2& circle_pos,
+        const WallCollider& wall, const glm::vec2& wall_pos,
+        glm::vec2& out_normal, float& out_penetration
+    ) {
+        // Broad phase using AABB
+        glm::vec2 closest = glm::max(
+            wall.aabb.min + wall_pos,
+            glm::min(circle_pos, wall.aabb.max + wall_pos)
+        );
+        glm::vec2 to_closest = circle_pos - closest;
+        if (glm::dot(to_closest, to_closest) > circle.radius * circle.radius) {
+            return false;  // No collision possible
+        }
+
+        // Test all edges at once, then the exact contact only for the edges that were hit
+        uint32_t hits = CollisionKernels::circle_segments(circle_pos, circle.radius, wall.edges.data(), wall.edges.size(), wall_pos);
+        if (hits == 0) return false;
+
+        bool collision = false;
+        float max_penetration = 0.0f;
+        glm::vec2 best_normal(0.0f, 0.0f);
+
+        for (size_t i = 0; i < wall.edges.size(); i++) {
+            if (!(hits & (1u << i))) continue;
+            glm::vec2 edge_normal;
+            float edge_penetration;
+
+            if (check_circle_segment(circle, circle_pos, wall.edges[i], wall_pos,
+                                     edge_normal, edge_penetration)) {
+                collision = true;
+                if (edge_penetration > max_penetration) {
+                    max_penetration = edge_penetration;
+                    best_normal = edge_normal;
+                }
+            }
+        }
+
+        if (collision) {
+            out_normal = best_normal;
+            out_penetration = max_penetration;
+        }
+
+        return collision;
+    }
+
+    /**
+     * Checks collision between a circle and a convex mesh
+     * Uses broad phase with bounding radius followed by detailed edge checks
+     * @param circle Circle collider
+     * @param circle_pos Circle position
+     * @param mesh Mesh collider containing vertices forming a convex hull
+     * @param mesh_pos Mesh position
+     * @return true if collision detected
+     */
+    inline bool check_circle_mesh(
+        const CircleCollider& circle, const glm::vec2& circle_pos,
+        const MeshCollider& mesh, const glm::vec2& mesh_pos
+    ) {
+        // Added logging because hard to debug mesh-based collisions; we can remove later
+        // Log::log_info(std::string("Processing collision between circle and mesh (") + 
+        //               std::to_string(mesh.vertices.size()) + " vertices)", 
+        //               __FILE__, __LINE__);
+
+        // Broad phase using bounding radius
+        if (glm::length(mesh_pos - circle_pos) > (circle.radius + mesh.bound_radius)) {
+            return false;
+        }
+
+        // Narrow phase: Check each edge of the mesh
+        for (size_t i = 0; i < mesh.vertices.size(); i++) {
+            const glm::vec2& v1 = mesh.vertices[i] + mesh_pos;
+            const glm::vec2& v2 = mesh.vertices[(i + 1) % mesh.vertices.size()] + mesh_pos;
+
+            // Create temporary segment for collision check
+            LineSegment segment{
+                v1 - mesh_pos,
+                v2 - mesh_pos,
+                glm::normalize(glm::vec2(-(v2.y - v1.y), v2.x - v1.x))  // Perpendicular normal
+            };
+
+            glm::vec2 normal;
+            float penetration;
+            if (check_circle_segment(circle, circle_pos, segment, mesh_pos, normal, penetration)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Contact normal and depth of two overlapping circles
+     * Coincident centres give a zero normal, the response then leaves both in place
+     * @param radius_sum Sum of the radii of both circles
+     * @param pos1 Position of first circle
+     * @param pos2 Position of second circle
+     * @param out_normal Output parameter for the unit vector from the second circle towards the first
+     * @param out_penetration Output parameter for the overlap along the normal
+     */
+    inline void circle_circle_contact(
+        float radius_sum, const glm::vec2& pos1, const glm::vec2& pos2,
+        glm::vec2& out_normal, float& out_penetration
+    ) {
+        glm::vec2 delta = pos1 - pos2;
+        float distance = glm::length(delta);
+        out_normal = distance > 0.0001f ? delta / distance : glm::vec2(0.0f);
+        out_penetration = radius_sum - distance;
+    }
+
+    /**
+     * Narrow phase test of one pair of colliders, in either order
+     * Meshes only report whether they overlap, their contact is approximated by their bounding circle
+     * @param out_normal Output parameter for the unit vector from j towards i, moving i along it separates the pair
+     * @param out_penetration Output parameter for the overlap along the normal
+     * @return true if the colliders overlap
+     */
+    inline bool test_pair(
+        const CollisionBounds& bounds_i, const Motion& motion_i,
+        const CollisionBounds& bounds_j, const Motion& motion_j,
+        glm::vec2& out_normal, float& out_penetration
+    ) {
+        bool collision = false;
+
+        // Handle all possible collider type combinations
+        if (bounds_i.type == ColliderType::Circle) {
+            switch (bounds_j.type) {
+                case ColliderType::Circle:
+                    collision = check_circle_circle(
+                        bounds_i.circle, motion_i.position,
+                        bounds_j.circle, motion_j.position
+                    );
+                    if (collision) {
+                        circle_circle_contact(bounds_i.circle.radius + bounds_j.circle.radius,
+                                              motion_i.position, motion_j.position,
+                                              out_normal, out_penetration);
+                    }
+                    break;
+
+                case ColliderType::Wall:
+                    collision = check_circle_wall(
+                        bounds_i.circle, motion_i.position,
+                        *bounds_j.wall, motion_j.position,
+                        out_normal, out_penetration
+                    );
+                    break;
+
+                case ColliderType::Mesh:
+                    collision = check_circle_mesh(
+                        bounds_i.circle, motion_i.position,
+                        *bounds_j.mesh, motion_j.position
+                    );
+                    if (collision) {
+                        circle_circle_contact(bounds_i.circle.radius + bounds_j.mesh->bound_radius,
+                                              motion_i.position, motion_j.position,
+                                              out_normal, out_penetration);
+                    }
+                    break;
+
+                case ColliderType::AABB:
+                    // Handle AABB collision or log warning
+                    break;
+            }
+            return collision;
+        }
+
+        // Handle reverse cases (when first entity is not a circle) by testing the other order
+        if (bounds_j.type == ColliderType::Circle) {
+            collision = test_pair(bounds_j, motion_j, bounds_i, motion_i, out_normal, out_penetration);
+            out_normal = -out_normal;  // Reverse normal for correct response
+            return collision;
+        }
+
+        if (bounds_i.type == ColliderType::Mesh && bounds_j.type == ColliderType::Wall) {
+            CircleCollider temp_circle{bounds_i.mesh->bound_radius};
+            collision = check_circle_wall(
+                temp_circle, motion_i.position,
+                *bounds_j.wall, motion_j.position,
+                out_normal, out_penetration
+            );
+        } else if (bounds_i.type == ColliderType::Wall && bounds_j.type == ColliderType::Mesh) {
+            CircleCollider temp_circle{bounds_j.mesh->bound_radius};
+            collision = check_circle_wall(
+                temp_circle, motion_j.position,
+                *bounds_i.wall, motion_i.position,
+                out_normal, out_penetration
+            );
+            out_normal = -out_normal;  // Reverse normal for correct response
+        }
+        // Mesh-mesh, wall-wall and AABB collisions are not handled
+
+        return collision;
+    }
+
+    /**
+     * Time of impact of a point moving from start by delta against a circle
+     * @param start Position of the point at time 0
+     * @param delta Motion of the point from time 0 to time 1
+     * @param center Circle position
+     * @param radius Circle radius
+     * @param out_time Output parameter for the first time in [0, 1] the point is in the circle, 0 if it starts inside
+     * @return true if the point enters the circle before time 1
+     */
+    inline bool sweep_point_circle(
+        const glm::vec2& start, const glm::vec2& delta,
+        const glm::vec2& center, float radius,
+        float& out_time
+    ) {
+        glm::vec2 offset = start - center;
+        float c = glm::dot(offset, offset) - radius * radius;
+        if (c <= 0.0f) {
+            out_time = 0.0f;  // Starts inside
+            return true;
+        }
+        float a = glm::dot(delta, delta);
+        float b = glm::dot(offset, delta);
+        if (a < 1e-12f || b >= 0.0f) return false;  // Not moving, or moving away
+        float discriminant = b * b - a * c;
+        if (discriminant < 0.0f) return false;
+        float t = (-b - std::sqrt(discriminant)) / a;
+        if (t > 1.0f) return false;
+        out_time = std::max(t, 0.0f);
+        return true;
+    }
+
+    /**
+     * Time of impact of a circle moving from start by delta against a line segment, as a point against the capsule
+     * of the segment: its two end circles and the two sides parallel to it
+     * @param start Circle position at time 0
+     * @param delta Motion of the circle from time 0 to time 1
+     * @param radius Circle radius
+     * @param segment Line segment to check against
+     * @param offset World space offset for the segment
+     * @param out_time Output parameter for the first time in [0, 1] the circle touches the segment
+     * @return true if the circle touches the segment before time 1
+     */
+    inline bool sweep_circle_segment(
+        const glm::vec2& start, const glm::vec2& delta, float radius,
+        const LineSegment& segment, const glm::vec2& offset,
+        float& out_time
+    ) {
+        glm::vec2 p0 = segment.start + offset;
+        glm::vec2 p1 = segment.end + offset;
+        glm::vec2 edge = p1 - p0;
+        float length_sq = glm::dot(edge, edge);
+
+        bool hit = false;
+        float best = 2.0f;
+        float t;
+        if (sweep_point_circle(start, delta, p0, radius, t) && t < best) { best = t; hit = true; }
+        if (sweep_point_circle(start, delta, p1, radius, t) && t < best) { best = t; hit = true; }
+        if (length_sq < 0.0001f * 0.0001f) {
+            out_time = best;
+            return hit;  // Degenerate segment, only its end circles
+        }
+
+        // The side of the capsule the circle starts on, reached when the distance to the line equals the radius
+        glm::vec2 normal = glm::vec2(-edge.y, edge.x) / std::sqrt(length_sq);
+        float distance = glm::dot(start - p0, normal);
+        float approach = glm::dot(delta, normal);
+        if (std::abs(distance) <= radius) {
+            // Already within the band of the line, inside the capsule if the projection falls on the segment
+            float u = glm::dot(start - p0, edge) / length_sq;
+            if (u >= 0.0f && u <= 1.0f) {
+                out_time = 0.0f;
+                return true;
+            }
+        } else if (distance * approach < 0.0f) {
+            float side = distance > 0.0f ? radius : -radius;
+            t = (side - distance) / approach;
+            if (t <= 1.0f && t < best) {
+                float u = glm::dot(start + delta * t - p0, edge) / length_sq;
+                if (u >= 0.0f && u <= 1.0f) { best = t; hit = true; }
+            }
+        }
+        out_time = best;
+        return hit;
+    }
+
+    /**
+     * Folds the touch of a moving circle with one segment into the earliest touch so far
+     * @param start Circle position at time 0
+     * @param delta Motion of the circle from time 0 to time 1
+     * @param radius Circle radius
+     * @param segment Line segment to check against
+     * @param offset World space offset for the segment
+     * @param best_time The earliest touch so far, lowered to this segment's touch if it is earlier
+     * @param best_point Output parameter for the closest point of the segment to the circle at an earlier touch
+     * @return true if the segment is touched before best_time
+     */
+    inline bool sweep_circle_segment_earliest(
+        const glm::vec2& start, const glm::vec2& delta, float radius,
+        const LineSegment& segment, const glm::vec2& offset,
+        float& best_time, glm::vec2& best_point
+    ) {
+        float t;
+        if (!sweep_circle_segment(start, delta, radius, segment, offset, t) || t >= best_time) return false;
+        best_time = t;
+        glm::vec2 p0 = segment.start + offset;
+        glm::vec2 e = segment.end - segment.start;
+        float length_sq = glm::dot(e, e);
+        float u = length_sq > 0.0f ? glm::clamp(glm::dot(start + delta * t - p0, e) / length_sq, 0.0f, 1.0f) : 0.0f;
+        best_point = p0 + e * u;
+        return true;
+    }
+
+    /**
+     * Swept test of a fast circle, or the bounding circle of a fast mesh, against another collider that is taken to
+     * stand still during the step. Walls are tested edge by edge, circles and meshes by their (bounding) circle.
+     * @param bounds_i Collider shape of the moving entity
+     * @param start_i Position of the moving entity before the step
+     * @param end_i Position of the moving entity after the step
+     * @param out_time Output parameter for the fraction of the step at the first touch
+     * @param out_normal Output parameter for the unit vector from j towards i at the first touch
+     * @return true if the moving collider touches j during the step
+     */
+    inline bool sweep_pair(
+        const CollisionBounds& bounds_i, const glm::vec2& start_i, const glm::vec2& end_i,
+        const CollisionBounds& bounds_j, const Motion& motion_j,
+        float& out_time, glm::vec2& out_normal
+    ) {
+        float radius_i;
+        if (bounds_i.type == ColliderType::Circle) {
+            radius_i = bounds_i.circle.radius;
+        } else if (bounds_i.type == ColliderType::Mesh) {
+            radius_i = bounds_i.mesh->bound_radius;
+        } else {
+            return false;
+        }
+        const glm::vec2 delta = end_i - start_i;
+
+        bool hit = false;
+        glm::vec2 contact_point;
+        switch (bounds_j.type) {
+            case ColliderType::Circle:
+            case ColliderType::Mesh: {
+                float radius_j = bounds_j.type == ColliderType::Circle ? bounds_j.circle.radius : bounds_j.mesh->bound_radius;
+                hit = sweep_point_circle(start_i, delta, motion_j.position, radius_i + radius_j, out_time);
+                contact_point = motion_j.position;
+                break;
+            }
+            case ColliderType::Wall: {
+                out_time = 2.0f;
+                for (const LineSegment& edge : bounds_j.wall->edges) {
+                    hit |= sweep_circle_segment_earliest(start_i, delta, radius_i, edge, motion_j.position, out_time, contact_point);
+                }
+                break;
+            }
+            case ColliderType::AABB:
+                break;
+        }
+        if (hit) {
+            glm::vec2 away = start_i + delta * out_time - contact_point;
+            float length = glm::length(away);
+            out_normal = length > 0.0001f ? away / length : glm::vec2(0.0f);
+        }
+        return hit;
+    }
+
+    /**
+     * World space bounding box of a collider, covering everything test_pair can find it colliding with
+     * @param bounds Collider shape
+     * @param motion Motion holding the collider's position
+     * @param out_min Output parameter for the lower corner
+     * @param out_max Output parameter for the upper corner
+     */
+    inline void collider_aabb(const CollisionBounds& bounds, const Motion& motion, glm::vec2& out_min, glm::vec2& out_max) {
+        switch (bounds.type) {
+            case ColliderType::Circle:
+                out_min = motion.position - glm::vec2(bounds.circle.radius);
+                out_max = motion.position + glm::vec2(bounds.circle.radius);
+                break;
+            case ColliderType::Wall:
+                out_min = motion.position + bounds.wall->aabb.min;
+                out_max = motion.position + bounds.wall->aabb.max;
+                break;
+            case ColliderType::Mesh:
+                out_min = motion.position - glm::vec2(bounds.mesh->bound_radius);
+                out_max = motion.position + glm::vec2(bounds.mesh->bound_radius);
+                break;
+            case ColliderType::AABB:
+                out_min = bounds.aabb.min;
+                out_max = bounds.aabb.max;
+                break;
+        }
+    }
+
+    /**
+     * Rebuilds the static collider BVH if it was built from another registry or a wall or static object was
+     * added or removed since. Walls and static objects are placed once and never move, see Application's wall cache.
+     * @param registry Active registry
+     */
+    inline void update_static_colliders(Registry& registry) {
+        StaticColliders& static_colliders = broad_phase().static_colliders;
+        const ChangeVersion since = static_colliders.version;
+        if (registry.id() == static_colliders.registry_id
+            && registry.walls.last_structural_change() < since
+            && registry.static_objects.last_structural_change() < since
+            && registry.collision_bounds.last_structural_change() < since) {
+            return;
+        }
+        static_colliders.registry_id = registry.id();
+        static_colliders.version = registry.change_version();
+
+        std::vector<StaticBVH::Item> items;
+        items.reserve(registry.walls.size() + registry.static_objects.size());
+        auto add = [&](Entity entity, CollisionBounds& bounds, Motion& motion) {
+            StaticBVH::Item item{ glm::vec2(0.0f), glm::vec2(0.0f), entity };
+            collider_aabb(bounds, motion, item.min, item.max);
+            items.push_back(item);
+        };
+        registry.view<Wall, CollisionBounds, Motion, Team>().each([&](Entity entity, Wall&, CollisionBounds& bounds, Motion& motion, Team&) {
+            add(entity, bounds, motion);
+        });
+        registry.view<StaticObject, CollisionBounds, Motion, Team>().exclude<Wall>().each([&](Entity entity, StaticObject&, CollisionBounds& bounds, Motion& motion, Team&) {
+            add(entity, bounds, motion);
+        });
+        static_colliders.bvh.build(std::move(items));
+    }
+
+    /**
+     * Broad phase radius of a moving collider, the spatial hash finds every collider within it of the position
+     */
+    inline float broad_phase_radius(const CollisionBounds& bounds) {
+        if (bounds.type == ColliderType::Circle) {
+            return bounds.circle.radius;
+        } else if (bounds.type == ColliderType::Wall) {
+            // Use half diagonal of AABB for walls
+            glm::vec2 half_size = (bounds.wall->aabb.max - bounds.wall->aabb.min) * 0.5f;
+            return glm::length(half_size);
+        } else if (bounds.type == ColliderType::Mesh) {
+            return bounds.mesh->bound_radius;
+        }
+        return 0.0f;
+    }
+
+    /**
+     * Whether a point lies inside a convex polygon, given by its corners in order, in either winding
+     * @param point Point to test
+     * @param count Number of corners
+     * @param corner Callable returning corner k in world space
+     */
+    template <typename Corner>
+    inline bool inside_convex(const glm::vec2& point, size_t count, Corner corner) {
+        if (count < 3) return false;
+        bool left = false;
+        bool right = false;
+        for (size_t k = 0; k < count; k++) {
+            glm::vec2 a = corner(k);
+            glm::vec2 b = corner((k + 1) % count);
+            float cross = (b.x - a.x) * (point.y - a.y) - (b.y - a.y) * (point.x - a.x);
+            left |= cross > 0.0f;
+            right |= cross < 0.0f;
+        }
+        return !(left && right);
+    }
+
+    /**
+     * Exact cast of a circle against one collider: walls edge by edge, meshes by the edges of their hull and circles
+     * by their radius. A cast that starts inside the collider touches it at once.
+     * @param start Cast position at fraction 0
+     * @param delta Motion of the cast from fraction 0 to fraction 1
+     * @param radius Cast radius, 0 for a ray
+     * @param bounds Collider shape
+     * @param position Collider position
+     * @param out_fraction Output parameter for the fraction at the first touch
+     * @param out_normal Output parameter for the unit vector from the collider towards the cast at the first touch,
+     * zero if the cast starts inside
+     * @return true if the cast touches the collider before fraction 1
+     */
+    inline bool cast_collider(
+        const glm::vec2& start, const glm::vec2& delta, float radius,
+        const CollisionBounds& bounds, const glm::vec2& position,
+        float& out_fraction, glm::vec2& out_normal
+    ) {
+        bool hit = false;
+        glm::vec2 contact_point = position;
+        glm::vec2 contact_edge(0.0f);
+        out_fraction = 2.0f;
+        switch (bounds.type) {
+            case ColliderType::Circle:
+                hit = sweep_point_circle(start, delta, position, radius + bounds.circle.radius, out_fraction);
+                break;
+
+            case ColliderType::Wall: {
+                const std::vector<LineSegment>& edges = bounds.wall->edges;
+                if (inside_convex(start, edges.size(), [&](size_t k) { return edges[k].start + position; })) {
+                    out_fraction = 0.0f;
+                    out_normal = glm::vec2(0.0f);
+                    return true;
+                }
+                for (const LineSegment& edge : edges) {
+                    if (sweep_circle_segment_earliest(start, delta, radius, edge, position, out_fraction, contact_point)) {
+                        hit = true;
+                        contact_edge = edge.end - edge.start;
+                    }
+                }
+                break;
+            }
+
+            case ColliderType::Mesh: {
+                // Most casts pass the bounding circle by
+                float t;
+                if (!sweep_point_circle(start, delta, position, radius + bounds.mesh->bound_radius, t)) return false;
+                const std::vector<glm::vec2>& vertices = bounds.mesh->vertices;
+                if (inside_convex(start, vertices.size(), [&](size_t k) { return vertices[k] + position; })) {
+                    out_fraction = 0.0f;
+                    out_normal = glm::vec2(0.0f);
+                    return true;
+                }
+                for (size_t k = 0; k < vertices.size(); k++) {
+                    LineSegment edge{ vertices[k], vertices[(k + 1) % vertices.size()], glm::vec2(0.0f) };
+                    if (sweep_circle_segment_earliest(start, delta, radius, edge, position, out_fraction, contact_point)) {
+                        hit = true;
+                        contact_edge = edge.end - edge.start;
+                    }
+                }
+                break;
+            }
+
+            case ColliderType::AABB:
+                break;
+        }
+        if (!hit) return false;
+
+        glm::vec2 away = start + delta * out_fraction - contact_point;
+        float length = glm::length(away);
+        if (length > 0.0001f) {
+            out_normal = away / length;
+        } else if (contact_edge != glm::vec2(0.0f)) {
+            // A ray touches the edge itself, its normal faces the ray
+            out_normal = glm::normalize(glm::vec2(-contact_edge.y, contact_edge.x));
+            if (glm::dot(out_normal, delta) > 0.0f) out_normal = -out_normal;
+        } else {
+            out_normal = glm::vec2(0.0f);
+        }
+        return true;
+    }
+
+    /**
+     * Exact overlap of a circle with one collider, including circles inside walls and meshes
+     * @param center Circle position
+     * @param radius Circle radius, 0 for a point
+     * @param bounds Collider shape
+     * @param position Collider position
+     * @return true if the circle and the collider overlap
+     */
+    inline bool overlap_collider(const glm::vec2& center, float radius, const CollisionBounds& bounds, const glm::vec2& position) {
+        switch (bounds.type) {
+            case ColliderType::Circle: {
+                glm::vec2 offset = center - position;
+                float radius_sum = radius + bounds.circle.radius;
+                return glm::dot(offset, offset) < radius_sum * radius_sum;
+            }
+
+            case ColliderType::Wall: {
+                const std::vector<LineSegment>& edges = bounds.wall->edges;
+                return CollisionKernels::circle_segments(center, radius, edges.data(), edges.size(), position) != 0
+                    || inside_convex(center, edges.size(), [&](size_t k) { return edges[k].start + position; });
+            }
+
+            case ColliderType::Mesh: {
+                glm::vec2 offset = center - position;
+                float radius_sum = radius + bounds.mesh->bound_radius;
+                if (glm::dot(offset, offset) >= radius_sum * radius_sum) return false;
+                const std::vector<glm::vec2>& vertices = bounds.mesh->vertices;
+                for (size_t k = 0; k < vertices.size(); k++) {
+                    LineSegment edge{ vertices[k], vertices[(k + 1) % vertices.size()], glm::vec2(0.0f) };
+                    if (CollisionKernels::circle_segment_scalar(center, radius, edge, position)) return true;
+                }
+                return inside_convex(center, vertices.size(), [&](size_t k) { return vertices[k] + position; });
+            }
+
+            case ColliderType::AABB:
+                break;
+        }
+        return false;
+    }
+
+    /**
+     * Which colliders a query looks at: walls and static objects, moving colliders, or both
+     */
+    enum class QueryScope {
+        Static,
+        Moving,
+        All
+    };
+
+    /**
+     * The first collider touched by a cast
+     */
+    struct CastHit {
+        Entity entity = Entity::null();  // Entity() would create an entity
+        float fraction = 1.0f;           // fraction of the way from start to end at the first touch
+        glm::vec2 position{ 0.0f };      // cast position at the first touch
+        glm::vec2 normal{ 0.0f };        // unit vector from the collider towards the cast, zero if it started inside
+    };
+
+    /**
+     * Calls func(entity) for the colliders in scope that may overlap the box (min, max)
+     * Static colliders come from the BVH, moving ones from the spatial hash, found where the last check_collisions
+     * saw them, so queries belong after it in the frame
+     */
+    template <typename Func>
+    inline void for_each_candidate(const glm::vec2& min, const glm::vec2& max, QueryScope scope, Func func) {
+        const BroadPhase& world = broad_phase();
+        if (scope != QueryScope::Moving) {
+            world.static_colliders.bvh.query(min, max, func);
+        }
+        if (scope != QueryScope::Static) {
+            world.spatial_hash.for_each((min + max) * 0.5f, glm::length(max - min) * 0.5f + world.max_moving_radius, func);
+        }
+    }
+
+    // Casts go through the broad phase in pieces of this length, nearest first
+    static constexpr float CAST_PIECE_LENGTH = 2.0f * CELL_SIZE;
+
+    /**
+     * Casts a circle from start to end against the colliders of the active registry
+     * Long casts query the broad phase piece by piece from the start, so a near hit skips the rest of the way and no
+     * query covers more than a few cells. Reads the registry through const access and never allocates, so several
+     * threads may cast at once while nothing writes colliders.
+     * @param start Cast position at fraction 0
+     * @param end Cast position at fraction 1
+     * @param radius Cast radius, 0 for a ray
+     * @param scope Colliders to test
+     * @param filter Callable taking an Entity, returns false for colliders the cast passes through
+     * @param out_hit Output parameter for the first touch
+     * @return true if the cast touches a collider on the way
+     */
+    template <typename Filter>
+    inline bool circle_cast(
+        const glm::vec2& start, const glm::vec2& end, float radius,
+        QueryScope scope, Filter filter, CastHit& out_hit
+    ) {
+        const Registry& registry = MapManager::get_instance().get_active_registry();
+        const glm::vec2 delta = end - start;
+        const size_t pieces = std::max<size_t>(1, size_t(std::ceil(glm::length(delta) / CAST_PIECE_LENGTH)));
+
+        bool hit = false;
+        out_hit.fraction = 2.0f;
+        for (size_t k = 0; k < pieces; k++) {
+            // Every touch before the start of this piece has been found by the earlier pieces
+            const float from = float(k) / float(pieces);
+            if (hit && out_hit.fraction <= from) break;
+
+            const glm::vec2 a = start + delta * from;
+            const glm::vec2 b = start + delta * (float(k + 1) / float(pieces));
+            for_each_candidate(glm::min(a, b) - radius, glm::max(a, b) + radius, scope, [&](Entity entity) {
+                if (!registry.valid(entity)) return;
+                const CollisionBounds* bounds = registry.collision_bounds.try_get(entity);
+                const Motion* motion = registry.motions.try_get(entity);
+                if (!bounds || !motion || !filter(entity)) return;
+
+                float fraction;
+                glm::vec2 normal;
+                // Ties go to the smaller id, so the result does not depend on the order of the candidates
+                if (cast_collider(start, delta, radius, *bounds, motion->position, fraction, normal)
+                    && (fraction < out_hit.fraction || (fraction == out_hit.fraction && entity.get_id() < out_hit.entity.get_id()))) {
+                    hit = true;
+                    out_hit.entity = entity;
+                    out_hit.fraction = fraction;
+                    out_hit.normal = normal;
+                }
+            });
+        }
+        if (!hit) {
+            out_hit.fraction = 1.0f;
+            return false;
+        }
+        out_hit.position = start + delta * out_hit.fraction;
+        return true;
+    }
+
+    /**
+     * Casts a ray from start to end, see circle_cast
+     */
+    template <typename Filter>
+    inline bool raycast(const glm::vec2& start, const glm::vec2& end, QueryScope scope, Filter filter, CastHit& out_hit) {
+        return circle_cast(start, end, 0.0f, scope, filter, out_hit);
+    }
+
+    /**
+     * Whether nothing in scope that passes the filter lies between two points
+     */
+    template <typename Filter>
+    inline bool line_of_sight(const glm::vec2& from, const glm::vec2& to, QueryScope scope, Filter filter) {
+        CastHit hit;
+        return !raycast(from, to, scope, filter, hit);
+    }
+
+    /**
+     * Calls func(entity) once for every collider in scope of the active registry that overlaps the circle and
+     * passes the filter. Never allocates; func must not add or remove colliders.
+     * @param center Circle position
+     * @param radius Circle radius, 0 for a point
+     * @param scope Colliders to test
+     * @param filter Callable taking an Entity, returns false for colliders to skip
+     * @param func Callable taking each overlapping Entity
+     */
+    template <typename Filter, typename Func>
+    inline void overlap_circle(const glm::vec2& center, float radius, QueryScope scope, Filter filter, Func func) {
+        const Registry& registry = MapManager::get_instance().get_active_registry();
+        for_each_candidate(center - radius, center + radius, scope, [&](Entity entity) {
+            if (!registry.valid(entity)) return;
+            const CollisionBounds* bounds = registry.collision_bounds.try_get(entity);
+            const Motion* motion = registry.motions.try_get(entity);
+            if (!bounds || !motion || !filter(entity)) return;
+            if (overlap_collider(center, radius, *bounds, motion->position)) func(entity);
+        });
+    }
+} // namespace CollisionSystem
@@ -4,127 +4,125 @@
 #include <app/World.h>
 #include "../ecs/Registry.hpp"
 #include <app/EntityFactory.hpp>
+#include "CollisionWorld.hpp"
 
 namespace GameplaySystem {
     inline void truly_attack(Entity& e, bool from_boss = false, BOSS_ATTACK_TYPE attack_type = BOSS_ATTACK_TYPE::REGULAR); // in order to use it in update_cooldowns
 
     inline void update_cooldowns(float elapsed_ms) {
         Registry& registry = MapManager::get_instance().get_active_registry();
+        CommandBuffer& cmd = registry.commands;
 
-        std::vector<Entity> to_be_removed;
-
-        to_be_removed.reserve(registry.attack_cooldowns.size());
-        for (Entity& e : registry.attack_cooldowns.entities) {
-            auto& attack_cooldown = registry.attack_cooldowns.get(e);
+        registry.view<AttackCooldown>().each([&](Entity e, AttackCooldown& attack_cooldown) {
             attack_cooldown.timer -= elapsed_ms / 1000.0f;
             if (attack_cooldown.timer <= 0) {
-                to_be_removed.push_back(e);
+                cmd.remove<AttackCooldown>(e);
             }
-        }
-        for (Entity& e : to_be_removed) {
-            registry.attack_cooldowns.remove(e);
-        }
+        });
 
-        to_be_removed.clear();
-        to_be_removed.reserve(registry.energy_no_regen_cooldowns.size());
-        for (Entity& e : registry.energy_no_regen_cooldowns.entities) {
-            auto& energy_no_regen_cooldown = registry.energy_no_regen_cooldowns.get(e);
+        registry.view<EnergyNoRegenCooldown>().each([&](Entity e, EnergyNoRegenCooldown& energy_no_regen_cooldown) {
             energy_no_regen_cooldown.timer -= elapsed_ms / 1000.0f;
             if (energy_no_regen_cooldown.timer <= 0) {
-                to_be_removed.push_back(e);
+                cmd.remove<EnergyNoRegenCooldown>(e);
             }
-        }
-        for (Entity& e : to_be_removed) {
-            registry.energy_no_regen_cooldowns.remove(e);
-        }
+        });
 
-        to_be_removed.clear();
-        to_be_removed.reserve(registry.stagger_cooldowns.size());
-        for (Entity& e : registry.stagger_cooldowns.entities) {
-            auto& stagger_cooldown = registry.stagger_cooldowns.get(e);
+        registry.view<StaggerCooldown>().each([&](Entity e, StaggerCooldown& stagger_cooldown) {
             stagger_cooldown.timer -= elapsed_ms / 1000.0f;
             if (stagger_cooldown.timer <= 0) {
-                to_be_removed.push_back(e);
+                cmd.remove<StaggerCooldown>(e);
             }
-        }
-        for (Entity& e : to_be_removed) {
-            registry.stagger_cooldowns.remove(e);
-        }
+        });
 
-        to_be_removed.clear();
-        to_be_removed.reserve(registry.death_cooldowns.entities.size());
-        for (Entity& e : registry.death_cooldowns.entities) {
-            auto& death_cooldown = registry.death_cooldowns.get(e);
+        bool player_died = false;
+        registry.view<DeathCooldown>().each([&](Entity e, DeathCooldown& death_cooldown) {
             death_cooldown.timer -= elapsed_ms / 1000.0f;
             if (death_cooldown.timer <= 0) {
-                to_be_removed.push_back(e);
-            }
-        }
-        for (Entity& e : to_be_removed) {
-            if (registry.player == e) {
-                World::restart_game();
-                return;
+                if (registry.player == e) {
+                    player_died = true;
+                } else {
+                    cmd.destroy(e);
+                }
             }
-            registry.remove_all_components_of(e);
+        });
+        if (player_died) {
+            // Replaces the registry, the recorded commands go with it
+            World::restart_game();
+            return;
         }
 
-        to_be_removed.clear();
-        to_be_removed.reserve(registry.buildups.entities.size());
-        for (Entity& e : registry.buildups.entities) {
-            auto& buildup = registry.buildups.get(e);
+        registry.view<AttackBuildup>().each([&](Entity e, AttackBuildup& buildup) {
             buildup.timer -= elapsed_ms / 1000.0f;
             if (buildup.timer <= 0) {
-                to_be_removed.push_back(e);
+                cmd.remove<AttackBuildup>(e);
                 truly_attack(e, buildup.from_boss, buildup.attack_type);
             }
-        }
-        for (Entity& e : to_be_removed) {
-            registry.buildups.remove(e);
-        }
+        });
     }
 
     inline void update_regen_stats(float elapsed_ms) {
         Registry& registry = MapManager::get_instance().get_active_registry();
 
-        for (Entity& e : registry.near_players.entities) {
-            if (registry.locomotion_stats.has(e)) {
-                auto& loco = registry.locomotion_stats.get(e);
-
-                if (!registry.energy_no_regen_cooldowns.has(e)) {
-                    loco.energy += Globals::energy_regen_rate * elapsed_ms / 1000.0f;
-                    loco.energy = fmin(loco.energy, loco.max_energy);
-                }
-                loco.poise += Globals::poise_regen_multiplier * loco.max_poise * elapsed_ms / 1000.0f;
-                loco.poise = fmin(loco.poise, loco.max_poise);
+        registry.view<NearPlayer, LocomotionStats>().each([&](Entity e, NearPlayer&, LocomotionStats& loco) {
+            if (!registry.energy_no_regen_cooldowns.has(e)) {
+                loco.energy += Globals::energy_regen_rate * elapsed_ms / 1000.0f;
+                loco.energy = fmin(loco.energy, loco.max_energy);
             }
-        }
+            loco.poise += Globals::poise_regen_multiplier * loco.max_poise * elapsed_ms / 1000.0f;
+            loco.poise = fmin(loco.poise, loco.max_poise);
+        });
     }
 
     inline void update_projectile_range(float elapsed_ms) {
         Registry& registry = MapManager::get_instance().get_active_registry();
 
-        std::vector<Entity> to_be_removed;
-
-        to_be_removed.reserve(registry.projectiles.size());
-        for (Entity& e : registry.projectiles.entities) {
-            Projectile& projectile = registry.projectiles.get(e);
-            projectile.range_remaining -= (elapsed_ms / 1000) * glm::length(registry.motions.get(e).velocity);
+        registry.view<Projectile, Motion>().each([&](Entity e, Projectile& projectile, Motion& motion) {
+            projectile.range_remaining -= (elapsed_ms / 1000) * glm::length(motion.velocity);
             if (projectile.range_remaining <= 0) {
-                to_be_removed.push_back(e);
+                registry.commands.destroy(e);
             }
-        }
-        for (Entity& e : to_be_removed) {
-            registry.remove_all_components_of(e);
-        }
+        });
+    }
+
+    template <typename Tag>
+    inline void _set_tag(bool tagged, TagContainer<Tag>& tags, Entity e) {
+        if (tagged) tags.set(e); else tags.remove(e);
     }
 
     inline void update_near_player_camera() {
         Registry& registry = MapManager::get_instance().get_active_registry();
 
+        auto& player_motion = registry.motions.get(registry.player);
+        NearTagsState& near_tags = registry.near_tags;
+        const ChangeVersion since = near_tags.version;
+        near_tags.version = registry.change_version();
+
+        // While neither the player nor the camera moves, only entities that moved or were added can change their
+        // tags. Resting trees, rocks and walls then cost nothing.
+        if (since != 0 && player_motion.position == near_tags.player_pos && registry.camera_pos == near_tags.camera_pos) {
+            auto near_camera = [&](Entity e, const Motion& motion) {
+                if (glm::distance(registry.camera_pos, motion.position) < Globals::update_distance) return true;
+                const LightSource* light = registry.light_sources.try_get(e);
+                return light && glm::distance(registry.camera_pos, glm::vec2(light->pos.x, light->pos.y)) < Globals::static_render_distance;
+            };
+            registry.view<Motion>().changed_since(since).each([&](Entity e, Motion& motion) {
+                _set_tag(glm::distance(player_motion.position, motion.position) < Globals::update_distance, registry.near_players, e);
+                _set_tag(near_camera(e, motion), registry.near_cameras, e);
+            });
+            registry.view<LightSource>().changed_since(since).each([&](Entity e, LightSource& light) {
+                if (glm::distance(registry.camera_pos, glm::vec2(light.pos.x, light.pos.y)) < Globals::static_render_distance) {
+                    registry.near_cameras.set(e);
+                }
+            });
+            return;
+        }
+        near_tags.player_pos = player_motion.position;
+        near_tags.camera_pos = registry.camera_pos;
+
+        // Both are TagContainers, so the rebuild is a fill of the bit words plus one bit set per nearby entity
         registry.near_players.clear();
         registry.near_cameras.clear();
 
-        auto& player_motion = registry.motions.get(registry.player);
         for (Entity& e : registry.motions.entities) {
             auto& motion = registry.motions.get(e);
 
@@ -143,7 +141,7 @@ namespace GameplaySystem {
             auto& light_pos = registry.light_sources.get(e).pos;
             float distance_camera = glm::distance(registry.camera_pos, glm::vec2(light_pos.x, light_pos.y));
             if (distance_camera < Globals::static_render_distance) {
-                if (!registry.near_cameras.has(e)) registry.near_cameras.emplace(e);
+                registry.near_cameras.set(e);
             }
         }
     }
@@ -209,7 +207,7 @@ namespace GameplaySystem {
 
         LocomotionStats& loco =  registry.locomotion_stats.get(registry.player);
         loco.health = fmin(loco.health + registry.estus.get(esti[0]).heal_amount, loco.max_health);
-        registry.remove_all_components_of(esti[0]);
+        registry.destroy(esti[0]);
         esti.erase(esti.begin());
     }
 
@@ -243,6 +241,12 @@ namespace GameplaySystem {
         // save here or in interaction
     }
 
+    // Targets behind walls and static objects cannot be locked on to. Tested last, only for better candidates.
+    inline bool can_lock_on(const glm::vec2& player_position, const glm::vec2& target_position) {
+        return CollisionSystem::line_of_sight(player_position, target_position, CollisionSystem::QueryScope::Static,
+                                              [](Entity) { return true; });
+    }
+
     inline void lock_on_target() {
         Registry& registry = MapManager::get_instance().get_active_registry();
         GLFWwindow* window = static_cast<GLFWwindow*>(Globals::ptr_window);
@@ -262,7 +266,7 @@ namespace GameplaySystem {
             auto& motion = registry.motions.get(e);
             if (glm::distance(player_motion.position, motion.position) > Globals::lock_target_range || registry.death_cooldowns.has(e)) continue;
             float angle = Common::get_angle_between_item_and_player_view(motion.position, player_motion.position, player_motion.angle);
-            if (angle < min_angle) {
+            if (angle < min_angle && can_lock_on(player_motion.position, motion.position)) {
                 registry.locked_target.target = e;
                 min_angle = angle;
             }
@@ -288,7 +292,7 @@ namespace GameplaySystem {
             auto& motion = registry.motions.get(e);
             if (glm::distance(player_motion.position, motion.position) > Globals::lock_target_range || registry.death_cooldowns.has(e)) continue;
             float angle = Common::get_angle_between_item_and_player_view(motion.position, player_motion.position, player_motion.angle - delta_mouse_x);
-            if (angle < min_angle) {
+            if (angle < min_angle && can_lock_on(player_motion.position, motion.position)) {
                 registry.locked_target.target = e;
                 min_angle = angle;
             }
@@ -301,21 +305,28 @@ namespace GameplaySystem {
     inline void boss_attack(Entity& e, Motion& motion, Attacker& attacker, Weapon& weapon, BOSS_ATTACK_TYPE type) {
         Registry& registry = MapManager::get_instance().get_active_registry();
 
+        // The projectiles are created at the next sync point, see CommandBuffer::spawn
+        auto spawn_projectile = [&registry, weapon](glm::vec2 position, float angle, glm::vec2 aim) {
+            registry.commands.spawn([position, angle, aim, weapon](Registry& registry) mutable {
+                EntityFactory::create_boss_projectile(registry, position, angle, aim, weapon);
+            });
+        };
+
         if (type == BOSS_ATTACK_TYPE::REGULAR) {
-            EntityFactory::create_boss_projectile(registry, motion.position, motion.angle, attacker.aim, weapon);
+            spawn_projectile(motion.position, motion.angle, attacker.aim);
             registry.attack_cooldowns.emplace(e, 0.3f);
         } else if (type == BOSS_ATTACK_TYPE::LONG) {
             glm::vec2 pos0 = glm::vec2(motion.position.x - cos(motion.angle), motion.position.y - sin(motion.angle));
             glm::vec2 pos2 = glm::vec2(motion.position.x + cos(motion.angle), motion.position.y + sin(motion.angle));
-            EntityFactory::create_boss_projectile(registry, pos0, motion.angle, attacker.aim, weapon);
-            EntityFactory::create_boss_projectile(registry, motion.position, motion.angle, attacker.aim, weapon);
-            EntityFactory::create_boss_projectile(registry, pos2, motion.angle, attacker.aim, weapon);
+            spawn_projectile(pos0, motion.angle, attacker.aim);
+            spawn_projectile(motion.position, motion.angle, attacker.aim);
+            spawn_projectile(pos2, motion.angle, attacker.aim);
             registry.attack_cooldowns.emplace(e, 0.5f);
         } else if (type == BOSS_ATTACK_TYPE::AOE) {
             for (int i = 0; i < 8; i++) {
                 float angle = motion.angle + i * PI / 4;
                 glm::vec2 aim = glm::vec2(cos(angle), sin(angle));
-                EntityFactory::create_boss_projectile(registry, motion.position, angle, aim, weapon);
+                spawn_projectile(motion.position, angle, aim);
             }
             registry.attack_cooldowns.emplace(e, 0.5f);
         }
@@ -329,7 +340,7 @@ namespace GameplaySystem {
         AudioSystem& audio = AudioSystem::get_instance();
 
         // was staggered or killed mid buildup
-        if (registry.stagger_cooldowns.has(e) || registry.death_cooldowns.has(e) || !registry.valid(e)) return;
+        if (registry.stagger_cooldowns.has(e) || registry.death_cooldowns.has(e) || !registry.valid(e) || registry.commands.is_destroy_pending(e)) return;
 
         Motion& motion = registry.motions.get(e);
         Attacker& attacker = registry.attackers.get(e);
@@ -338,7 +349,10 @@ namespace GameplaySystem {
         if (from_boss) {
             boss_attack(e, motion, attacker, weapon, attack_type);
         } else {
-            EntityFactory::create_projectile(registry, motion, attacker, weapon, registry.teams.get(e).team_id);
+            TEAM_ID team_id = registry.teams.get(e).team_id;
+            registry.commands.spawn([motion, attacker, weapon, team_id](Registry& registry) mutable {
+                EntityFactory::create_projectile(registry, motion, attacker, weapon, team_id);
+            });
             registry.attack_cooldowns.emplace(e, weapon.attack_cooldown);
             deplete_energy(e, weapon.attack_energy_cost);
         }
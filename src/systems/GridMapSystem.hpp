@@ -3,6 +3,7 @@
 #include <cmath>
 #include <globals/Globals.h>
 #include "../ecs/Registry.hpp"
+#include "utils/FrameArena.hpp"
 
 namespace GridMapSystem {
     inline void _clear_grid_map() {
@@ -48,17 +49,18 @@ namespace GridMapSystem {
     // }
 
     inline void update_grid_distances(std::vector<std::vector<GridMap::GridBox>> &grid_boxes, int x, int y) {
-        std::queue<std::pair<int, int>> points;
+        // Breadth-first search with the queue in the frame arena, points before head have been visited
+        FrameVector<std::pair<int, int>> points;
+        size_t head = 0;
         grid_boxes[x][y].distance = 0;
-        points.push({x, y});
+        points.push_back({x, y});
 
         const int directions[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}}; // Up, Down, Left, Right
 
-        while (!points.empty()) {
-            auto pair = points.front();
+        while (head < points.size()) {
+            auto pair = points[head++];
             auto cx = pair.first;
             auto cy = pair.second;
-            points.pop();
             int current_distance = grid_boxes[cx][cy].distance;
 
             for (const auto& dir : directions) {
@@ -68,7 +70,7 @@ namespace GridMapSystem {
                 if (nx >= 0 && nx < grid_boxes.size() && ny >= 0 && ny < grid_boxes[0].size() &&
                     !grid_boxes[nx][ny].is_occupied && grid_boxes[nx][ny].distance == -1) {
                     grid_boxes[nx][ny].distance = current_distance + 1;
-                    points.push({nx, ny});
+                    points.push_back({nx, ny});
                     }
             }
         }
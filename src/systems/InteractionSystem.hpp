@@ -1,11 +1,13 @@
 #pragma once
 
+#include "utils/FrameArena.hpp"
+
 namespace InteractionSystem {
     inline void update_near_interactable() {
         Registry& registry = MapManager::get_instance().get_active_registry();
         Motion& player_motion = registry.motions.get(registry.player);
 
-        std::vector<Entity> in_range_interactables;
+        FrameVector<Entity> in_range_interactables;
         for (Entity& e : registry.near_players.entities) {
             if (registry.interactables.has(e)) {
                 if (!registry.motions.has(e)) continue;
@@ -37,23 +39,23 @@ namespace InteractionSystem {
         Entity& near_inter = registry.near_interactable.interactable;
         Interactable& inter_comp = registry.interactables.get(near_inter);
         if (inter_comp.type == INTERACTABLE_TYPE::ITEM_PICKUP) {
-            registry.near_interactable.message = std::string("Press F to Pickup");
+            registry.near_interactable.message = "Press F to Pickup";
         } else if (inter_comp.type == INTERACTABLE_TYPE::DUNGEON_ENTRANCE) {
-            registry.near_interactable.message = std::string("Press F to Enter Dungeon");
+            registry.near_interactable.message = "Press F to Enter Dungeon";
         } else if (inter_comp.type == INTERACTABLE_TYPE::DUNGEON_EXIT) {
-            registry.near_interactable.message = std::string("Press F to Exit Dungeon");
+            registry.near_interactable.message = "Press F to Exit Dungeon";
         } else if (inter_comp.type == INTERACTABLE_TYPE::BONFIRE) {
             if (registry.in_rests.has(registry.player)) {
-                registry.near_interactable.message = std::string("Press F to Leave");
+                registry.near_interactable.message = "Press F to Leave";
             } else {
-                registry.near_interactable.message = std::string("Press F to Rest");
+                registry.near_interactable.message = "Press F to Rest";
             }
         } else if (inter_comp.type == INTERACTABLE_TYPE::SPIRE_ENTRANCE) {
-            registry.near_interactable.message = std::string("Press F to Enter Spire");
+            registry.near_interactable.message = "Press F to Enter Spire";
         } else if (inter_comp.type == INTERACTABLE_TYPE::SPIRE_EXIT) {
-            registry.near_interactable.message = std::string("Press F to Exit Spire");
+            registry.near_interactable.message = "Press F to Exit Spire";
         } else if (inter_comp.type == INTERACTABLE_TYPE::NPC) {
-            registry.near_interactable.message = std::string("Press F to Talk");
+            registry.near_interactable.message = "Press F to Talk";
         }
     }
 
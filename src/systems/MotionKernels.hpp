@@ -0,0 +1,108 @@
+#pragma once
+
+#include "../components/PhysicsComponents.hpp"
+
+#include <vector>
+#include <cmath>
+
+// SSE2 is part of every x64 target, and of x86 builds with /arch:SSE2 or -msse2
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MOTION_KERNELS_SSE2 1
+#include <emmintrin.h>
+#else
+#define MOTION_KERNELS_SSE2 0
+#endif
+
+// Struct-of-arrays copy of the Motion fields that the integration step reads and writes. PhysicsSystem::step
+// gathers the awake bodies into it, runs the kernel over whole arrays and scatters the results back, so the
+// Motion component itself keeps its layout for every other system.
+struct MotionSoA {
+    std::vector<float> position_x, position_y;
+    std::vector<float> velocity_x, velocity_y;
+    std::vector<float> acceleration_x, acceleration_y;
+    std::vector<float> drag;
+
+    size_t size() const {
+        return drag.size();
+    }
+
+    // Keeps the capacity for the next frame
+    void clear() {
+        position_x.clear(); position_y.clear();
+        velocity_x.clear(); velocity_y.clear();
+        acceleration_x.clear(); acceleration_y.clear();
+        drag.clear();
+    }
+
+    void push_back(const Motion& motion) {
+        position_x.push_back(motion.position.x); position_y.push_back(motion.position.y);
+        velocity_x.push_back(motion.velocity.x); velocity_y.push_back(motion.velocity.y);
+        acceleration_x.push_back(motion.acceleration.x); acceleration_y.push_back(motion.acceleration.y);
+        drag.push_back(motion.drag);
+    }
+
+    // Writes back the fields the kernel changes
+    void scatter(size_t i, Motion& motion) const {
+        motion.position = { position_x[i], position_y[i] };
+        motion.velocity = { velocity_x[i], velocity_y[i] };
+    }
+};
+
+namespace MotionKernels {
+    // Drag opposes the direction of motion, then velocity and position are integrated with explicit Euler.
+    // Same arithmetic as Common::normalize, so both kernels give the result of the old per-entity loop.
+    inline void integrate_scalar(MotionSoA& bodies, size_t begin, size_t end, float dt) {
+        for (size_t i = begin; i < end; i++) {
+            float vx = bodies.velocity_x[i];
+            float vy = bodies.velocity_y[i];
+            float mag = sqrtf(vx * vx + vy * vy);
+            float drag_x = mag == 0 ? 0.0f : -(vx / mag) * bodies.drag[i];
+            float drag_y = mag == 0 ? 0.0f : -(vy / mag) * bodies.drag[i];
+
+            vx += (bodies.acceleration_x[i] + drag_x) * dt;
+            vy += (bodies.acceleration_y[i] + drag_y) * dt;
+            bodies.velocity_x[i] = vx;
+            bodies.velocity_y[i] = vy;
+            bodies.position_x[i] += vx * dt;
+            bodies.position_y[i] += vy * dt;
+        }
+    }
+
+#if MOTION_KERNELS_SSE2
+    // Four bodies per iteration. The zero length case is handled with a mask instead of a branch.
+    inline void integrate_sse2(MotionSoA& bodies, float dt) {
+        const size_t count = bodies.size();
+        const size_t simd_end = count - count % 4;
+        const __m128 step = _mm_set1_ps(dt);
+        const __m128 zero = _mm_setzero_ps();
+
+        for (size_t i = 0; i < simd_end; i += 4) {
+            __m128 vx = _mm_loadu_ps(&bodies.velocity_x[i]);
+            __m128 vy = _mm_loadu_ps(&bodies.velocity_y[i]);
+            __m128 drag = _mm_loadu_ps(&bodies.drag[i]);
+
+            __m128 mag = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)));
+            __m128 moving = _mm_cmpneq_ps(mag, zero);
+            __m128 drag_x = _mm_and_ps(moving, _mm_sub_ps(zero, _mm_mul_ps(_mm_div_ps(vx, mag), drag)));
+            __m128 drag_y = _mm_and_ps(moving, _mm_sub_ps(zero, _mm_mul_ps(_mm_div_ps(vy, mag), drag)));
+
+            vx = _mm_add_ps(vx, _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(&bodies.acceleration_x[i]), drag_x), step));
+            vy = _mm_add_ps(vy, _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(&bodies.acceleration_y[i]), drag_y), step));
+            _mm_storeu_ps(&bodies.velocity_x[i], vx);
+            _mm_storeu_ps(&bodies.velocity_y[i], vy);
+            _mm_storeu_ps(&bodies.position_x[i], _mm_add_ps(_mm_loadu_ps(&bodies.position_x[i]), _mm_mul_ps(vx, step)));
+            _mm_storeu_ps(&bodies.position_y[i], _mm_add_ps(_mm_loadu_ps(&bodies.position_y[i]), _mm_mul_ps(vy, step)));
+        }
+        integrate_scalar(bodies, simd_end, count, dt);
+    }
+#endif
+
+    // Integrates every body in the arrays, with SSE2 where the target has it
+    inline void integrate(MotionSoA& bodies, float dt) {
+#if MOTION_KERNELS_SSE2
+        integrate_sse2(bodies, dt);
+#else
+        integrate_scalar(bodies, 0, bodies.size(), dt);
+#endif
+    }
+}
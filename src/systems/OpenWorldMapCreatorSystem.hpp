@@ -31,6 +31,7 @@ namespace OpenWorldMapCreatorSystem {
         std::uniform_real_distribution<float> dist_rotation(0.0f, 2.0f * PI);
 
         std::vector<glm::vec2> tree_positions;
+        std::vector<float> tree_rotations;
         int attempts = 1000;
         int trees_created = 0;
 
@@ -43,14 +44,16 @@ namespace OpenWorldMapCreatorSystem {
             glm::vec2 new_pos = center_position + offset;
 
             if (!is_in_restricted_center(new_pos) && is_position_valid(new_pos, tree_positions, min_distance)) {
-                EntityFactory::create_tree(registry, new_pos, tree_rotation);
                 tree_positions.push_back(new_pos);
+                tree_rotations.push_back(tree_rotation);
                 trees_created++;
             }
 
             attempts--;
         }
 
+        // All trees at once, so every container grows once
+        EntityFactory::spawn_trees(registry, tree_positions, tree_rotations);
         return tree_positions;
     }
 
@@ -72,13 +75,14 @@ namespace OpenWorldMapCreatorSystem {
                                   is_position_valid(new_pos, tree_positions, min_distance);
 
             if (valid_position) {
-                EntityFactory::create_rock(registry, new_pos);
                 rock_positions.push_back(new_pos);
                 rocks_created++;
             }
 
             attempts--;
         }
+
+        EntityFactory::spawn_batch(registry, EntityFactory::rock_prefab(), rock_positions);
     }
 
     inline void populate_open_world_map(Registry& registry) {
@@ -3,31 +3,64 @@
 #include "../ecs/Entity.hpp"
 #include "../components/Components.hpp"
 #include "../ecs/Registry.hpp"
+#include "MotionKernels.hpp"
 #include "utils/Common.hpp"
 
+// Set to 1 to integrate through the MotionSoA kernels instead of the Motion structs. Off by default: the
+// kernel itself is ~4x faster, but while Motion is stored as an array of structs the gather and scatter cost
+// more than it saves (see Benchmarks::motion_integration).
+#ifndef PHYSICS_SOA_INTEGRATION
+#define PHYSICS_SOA_INTEGRATION 0
+#endif
+
 namespace PhysicsSystem
 {
     inline void step(float elapsed_ms) {
         Registry& registry = MapManager::get_instance().get_active_registry();
+        const float dt = elapsed_ms / 1000.0f;
 
-        for (Entity& entity : registry.near_players.entities) {
-            if (registry.motions.has(entity) && !registry.death_cooldowns.has(entity)) {
-                Motion& motion = registry.motions.get(entity);
-                if (!registry.in_dodges.has(entity)) {
-                    glm::vec2 drag = -Common::normalize(motion.velocity) * motion.drag;
-                    motion.velocity += (motion.acceleration + drag) * (elapsed_ms / 1000.0f);
-                    motion.position += motion.velocity * (elapsed_ms / 1000.0f);
-                }
-                motion.angle += motion.rotation_velocity * (elapsed_ms / 1000.0f);
+#if PHYSICS_SOA_INTEGRATION
+        // Scratch buffers of the integration kernel, kept between frames to avoid reallocating
+        static MotionSoA bodies;
+        static std::vector<Motion*> body_motions;
+        bodies.clear();
+        body_motions.clear();
+#endif
 
-                if (registry.attackers.has(entity)) {
-                    if (registry.enemies.has(entity)) {
-                        Attacker& attacker = registry.attackers.get(entity);
-                        motion.angle = atan2(attacker.aim.y, attacker.aim.x);
-                    }
+        registry.view<NearPlayer, Motion>().exclude<DeathCooldown>().each([&](Entity entity, NearPlayer&, Motion& motion) {
+            // Where the swept collision test of this step starts
+            if (ContinuousCollision* continuous = registry.continuous_collisions.try_get(entity)) {
+                continuous->start = motion.position;
+            }
+            if (!registry.in_dodges.has(entity)) {
+#if PHYSICS_SOA_INTEGRATION
+                bodies.push_back(motion);
+                body_motions.push_back(&motion);
+                // The kernel runs later, so mark every body that may move
+                if (motion.velocity != glm::vec2(0.0f) || motion.acceleration != glm::vec2(0.0f)) registry.motions.mark_changed(entity);
+#else
+                glm::vec2 drag = -Common::normalize(motion.velocity) * motion.drag;
+                motion.velocity += (motion.acceleration + drag) * dt;
+                motion.position += motion.velocity * dt;
+                // Resting bodies, most of the open world, keep their change version
+                if (motion.velocity != glm::vec2(0.0f)) registry.motions.mark_changed(entity);
+#endif
+            }
+            motion.angle += motion.rotation_velocity * dt;
+
+            if (registry.enemies.has(entity)) {
+                if (Attacker* attacker = registry.attackers.try_get(entity)) {
+                    motion.angle = atan2(attacker->aim.y, attacker->aim.x);
                 }
             }
+        });
+
+#if PHYSICS_SOA_INTEGRATION
+        MotionKernels::integrate(bodies, dt);
+        for (size_t i = 0; i < body_motions.size(); i++) {
+            bodies.scatter(i, *body_motions[i]);
         }
+#endif
 
         // // update motion of follower entities
         // for (Entity& e : registry.move_withs.entities) {
@@ -45,8 +78,7 @@ namespace PhysicsSystem
     inline void update_interpolations() {
         Registry& registry = MapManager::get_instance().get_active_registry();
 
-        for (Entity& entity : registry.in_dodges.entities) {
-            InDodge& indodge = registry.in_dodges.get(entity);
+        registry.view<InDodge, Motion>().each([&](Entity entity, InDodge& indodge, Motion& motion) {
             float y1 = indodge.source.x;
             float y2 = indodge.destination.x;
             float x1 = indodge.origin_time / 1000000.0f;
@@ -58,11 +90,12 @@ namespace PhysicsSystem
             y2 = indodge.destination.y;
             float y_pos = y1 + (x - x1) * (y2 - y1) / (x2 - x1);
 
-            registry.motions.get(entity).position = glm::vec2(x_pos, y_pos);
+            motion.position = glm::vec2(x_pos, y_pos);
+            registry.motions.mark_changed(entity);
 
             if (x - x1 > indodge.duration) {
                 registry.in_dodges.remove(entity);
             }
-        }
+        });
     }
 };
\ No newline at end of file
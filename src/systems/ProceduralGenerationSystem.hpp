@@ -356,19 +356,28 @@ namespace ProceduralGenerationSystem {
             wall.startY = height/2 - wall.startY;
         }
 
-        // create the walls
+        // create the walls, all in one batch
+        std::vector<glm::vec2> positions;
+        std::vector<float> angles;
+        std::vector<glm::vec2> scales;
+        positions.reserve(walls.size());
+        angles.reserve(walls.size());
+        scales.reserve(walls.size());
         for (auto& wall : walls) {
             float x = wall.startX;
             float y = wall.startY;
 
             if (wall.horizontal) {
                 x += wall.length/2;
-                EntityFactory::create_wall(registry, {x, y}, 0, glm::vec2(wall.length, 1.0f));
+                angles.push_back(0);
             } else {
                 y -= wall.length/2;
-                EntityFactory::create_wall(registry, {x, y}, PI / 2.0f, glm::vec2(wall.length, 1.0f));
+                angles.push_back(PI / 2.0f);
             }
+            positions.push_back({x, y});
+            scales.push_back(glm::vec2(wall.length, 1.0f));
         }
+        EntityFactory::spawn_walls(registry, positions, angles, scales);
     }
 
     inline void place_light_sources(Registry& registry, const std::vector<Room>& rooms) {
@@ -400,6 +409,8 @@ namespace ProceduralGenerationSystem {
     }
 
     inline void create_enemies_and_objects(Registry& registry, const std::vector<Room>& rooms, const Room& spawn_room, int dungeon_difficutly) {
+        // The trees of every room are spawned in one batch at the end
+        std::vector<glm::vec2> tree_positions;
         for (const Room& room : rooms) {
             if (room == spawn_room) {
                 EntityFactory::create_portal(registry, {room.position.x - 9, room.position.y}, INTERACTABLE_TYPE::DUNGEON_EXIT);
@@ -442,10 +453,11 @@ namespace ProceduralGenerationSystem {
                     y = pos_y_dist(gen);
                 }
 
-                EntityFactory::create_tree(registry, {x, y});
+                tree_positions.push_back({x, y});
                 enemies_and_objects_pos.push_back({x, y});
             }
         }
+        EntityFactory::spawn_trees(registry, tree_positions, std::vector<float>(tree_positions.size(), 0.0f));
     }
 
     inline void generate_dungeon(Registry& registry, int map_width, int map_height, Motion& player_motion, int dungeon_difficulty) {
@@ -454,6 +466,7 @@ namespace ProceduralGenerationSystem {
         std::vector<Room> rooms;
         Room spawn_room = create_spawn_room(rooms, map_width, map_height);
         player_motion.position = spawn_room.position;
+        registry.motions.mark_changed(registry.player);
         generate_rooms(map_width, map_height, rooms);
         std::vector<Hallway> hallways = generate_hallways(rooms);
         connect_rooms(rooms, hallways, map, map_width, map_height);
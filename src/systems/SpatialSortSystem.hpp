@@ -0,0 +1,75 @@
+#pragma once
+
+#include "../ecs/Registry.hpp"
+#include "app/MapManager.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+// Keeps entities that are close in the world close in memory. Motions are ordered by the Morton (Z-order) code of
+// the cell their position is in, and the containers that are iterated together with motions follow that order, so
+// the collision broad phase, the AI neighbour checks and the proximity tag rebuild walk memory mostly forward
+// instead of jumping between pages.
+namespace SpatialSortSystem {
+    // Positions in one cell share a code, about the size of a CollisionSystem grid cell
+    constexpr float CELL_SIZE = 8.0f;
+
+    // Entities move slowly compared to the frame rate, so the order only has to be refreshed now and then
+    constexpr float SORT_INTERVAL_MS = 2000.0f;
+
+    // Spreads the low 16 bits of x over the even bits
+    inline unsigned int _spread_bits(unsigned int x) {
+        x &= 0x0000ffff;
+        x = (x | (x << 8)) & 0x00ff00ff;
+        x = (x | (x << 4)) & 0x0f0f0f0f;
+        x = (x | (x << 2)) & 0x33333333;
+        x = (x | (x << 1)) & 0x55555555;
+        return x;
+    }
+
+    // Cell coordinate shifted into 0..65535, positions further out than 32768 cells share the border cells
+    inline unsigned int _cell(float coordinate) {
+        const float cell = std::floor(coordinate / CELL_SIZE) + 32768.0f;
+        return (unsigned int)std::min(std::max(cell, 0.0f), 65535.0f);
+    }
+
+    // Interleaves the bits of the cell coordinates, so cells that are close mostly get close codes
+    inline unsigned int morton_code(const glm::vec2& position) {
+        return _spread_bits(_cell(position.x)) | (_spread_bits(_cell(position.y)) << 1);
+    }
+
+    // Reorders motions by position and the containers iterated with them like motions. Containers that are
+    // already in order are left alone, so calling this on a resting world writes nothing.
+    inline void sort_by_position(Registry& registry) {
+        const auto& motions = registry.motions.components; // read only, so pages shared with a snapshot are not copied
+        std::vector<unsigned int> codes(motions.size());
+        for (size_t i = 0; i < motions.size(); i++) {
+            codes[i] = morton_code(motions[i].position);
+        }
+        if (!std::is_sorted(codes.begin(), codes.end())) {
+            std::vector<unsigned int> order(codes.size());
+            std::iota(order.begin(), order.end(), 0u);
+            std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return codes[a] < codes[b]; });
+            registry.motions.apply_order(order);
+        }
+
+        registry.collision_bounds.sort_like(registry.motions);
+        registry.teams.sort_like(registry.motions);
+        registry.ais.sort_like(registry.motions);
+        registry.attackers.sort_like(registry.motions);
+        registry.locomotion_stats.sort_like(registry.motions);
+        registry.near_players.sort_like(registry.motions);
+        registry.near_cameras.sort_like(registry.motions);
+    }
+
+    // Sorts the active registry every SORT_INTERVAL_MS
+    inline void step(float elapsed_ms) {
+        static float since_sort_ms = 0.0f;
+        since_sort_ms += elapsed_ms;
+        if (since_sort_ms < SORT_INTERVAL_MS) return;
+        since_sort_ms = 0.0f;
+        sort_by_position(MapManager::get_instance().get_active_registry());
+    }
+};
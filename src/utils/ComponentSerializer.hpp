@@ -33,6 +33,20 @@ namespace ComponentSerializer {
         motion.drag = j["drag"];
     }
 
+    // ContinuousCollision serialization
+    inline json serialize_continuous_collision(const ContinuousCollision& continuous) {
+        return {
+            {"start", Serialization::serialize_vec2(continuous.start)}
+        };
+    }
+
+    inline void deserialize_continuous_collision(ContinuousCollision& continuous, const json& j) {
+        if (!j.contains("start")) {
+            throw SerializationError("Missing start in continuous_collision data");
+        }
+        Serialization::deserialize_vec2(continuous.start, j["start"]);
+    }
+
     // LocomotionStats serialization
     inline json serialize_locomotion_stats(const LocomotionStats& stats) {
         return {
@@ -183,11 +197,11 @@ namespace ComponentSerializer {
                 Serialization::deserialize_vec2(bounds.aabb.min, j["min"]);
                 Serialization::deserialize_vec2(bounds.aabb.max, j["max"]);
                 break;
-            case ColliderType::Wall:
-                bounds.wall = new WallCollider();
+            case ColliderType::Wall: {
+                WallCollider shape;
                 // Deserialize AABB
-                Serialization::deserialize_vec2(bounds.wall->aabb.min, j["aabb_min"]);
-                Serialization::deserialize_vec2(bounds.wall->aabb.max, j["aabb_max"]);
+                Serialization::deserialize_vec2(shape.aabb.min, j["aabb_min"]);
+                Serialization::deserialize_vec2(shape.aabb.max, j["aabb_max"]);
                 
                 // Deserialize edges
                 if (j.contains("edges")) {
@@ -196,23 +210,27 @@ namespace ComponentSerializer {
                         Serialization::deserialize_vec2(segment.start, edge["start"]);
                         Serialization::deserialize_vec2(segment.end, edge["end"]);
                         Serialization::deserialize_vec2(segment.normal, edge["normal"]);
-                        bounds.wall->edges.push_back(segment);
+                        shape.edges.push_back(segment);
                     }
                 }
+                bounds.wall = ColliderShapeLibrary::get_instance().intern(shape);
                 break;
-            case ColliderType::Mesh:
-                bounds.mesh = new MeshCollider();
-                bounds.mesh->bound_radius = j["bound_radius"];
+            }
+            case ColliderType::Mesh: {
+                MeshCollider shape;
+                shape.bound_radius = j["bound_radius"];
                 
                 // Deserialize vertices
                 if (j.contains("vertices")) {
                     for (const auto& vertex : j["vertices"]) {
                         glm::vec2 v;
                         Serialization::deserialize_vec2(v, vertex);
-                        bounds.mesh->vertices.push_back(v);
+                        shape.vertices.push_back(v);
                     }
                 }
+                bounds.mesh = ColliderShapeLibrary::get_instance().intern(shape);
                 break;
+            }
         }
     }
 
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Bump allocator for scratch data that only lives during one simulation frame, such as the candidate lists of the
+// broad phase. Allocating is a pointer increment and freeing does nothing; World::step resets every arena at the
+// top of the frame. An arena that ran out of room during a frame allocates another block, and the next reset
+// replaces all blocks with one that fits the whole frame, so after the first few frames it never touches the heap.
+//
+// Every thread has its own arena (FrameArena::local()), so jobs allocate without locking. Use it through
+// FrameAllocator, e.g. FrameVector<Entity>, and never keep such a container past the end of the frame.
+class FrameArena {
+public:
+    static constexpr size_t MIN_BLOCK_SIZE = 64 * 1024;
+
+    FrameArena() {
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment) {
+        void* result = bump(bytes, alignment);
+        if (!result) {
+            add_block(bytes + alignment);
+            result = bump(bytes, alignment);
+        }
+        return result;
+    }
+
+    // Frees everything allocated since the last reset
+    void reset() {
+        if (!m_retired.empty()) {
+            size_t total = m_block_size;
+            for (const Block& block : m_retired) total += block.size;
+            m_retired.clear();
+            m_block.reset(new char[total]);
+            m_block_size = total;
+        }
+        m_offset = 0;
+    }
+
+    // Bytes handed out since the last reset, including alignment padding
+    size_t bytes_used() const {
+        size_t used = m_offset;
+        for (const Block& block : m_retired) used += block.used;
+        return used;
+    }
+
+    size_t capacity() const {
+        size_t total = m_block_size;
+        for (const Block& block : m_retired) total += block.size;
+        return total;
+    }
+
+    // The arena of the calling thread, created on first use
+    static FrameArena& local() {
+        static thread_local FrameArena* arena = nullptr;
+        if (!arena) {
+            ThreadArenas& threads = thread_arenas();
+            std::lock_guard<std::mutex> lock(threads.mutex);
+            threads.arenas.push_back(std::make_shared<FrameArena>());
+            arena = threads.arenas.back().get();
+        }
+        return *arena;
+    }
+
+    // Resets the arena of every thread. Only call while no thread is using its arena, as World::step does.
+    static void reset_all() {
+        ThreadArenas& threads = thread_arenas();
+        std::lock_guard<std::mutex> lock(threads.mutex);
+        for (auto& arena : threads.arenas) arena->reset();
+    }
+
+    // Bytes used this frame by all threads, for the profiler overlay and benchmarks
+    static size_t total_bytes_used() {
+        ThreadArenas& threads = thread_arenas();
+        std::lock_guard<std::mutex> lock(threads.mutex);
+        size_t used = 0;
+        for (auto& arena : threads.arenas) used += arena->bytes_used();
+        return used;
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> memory;
+        size_t size;
+        size_t used;
+    };
+
+    // The arenas of all threads. Threads that exit leave theirs behind, the job system only starts threads once.
+    struct ThreadArenas {
+        std::mutex mutex;
+        std::vector<std::shared_ptr<FrameArena>> arenas;
+    };
+
+    static ThreadArenas& thread_arenas() {
+        static ThreadArenas threads;
+        return threads;
+    }
+
+    std::unique_ptr<char[]> m_block;
+    size_t m_block_size = 0;
+    size_t m_offset = 0;
+    std::vector<Block> m_retired; // full blocks of the current frame
+
+    void* bump(size_t bytes, size_t alignment) {
+        if (!m_block) return nullptr;
+        const uintptr_t base = reinterpret_cast<uintptr_t>(m_block.get());
+        const uintptr_t aligned = (base + m_offset + alignment - 1) & ~uintptr_t(alignment - 1);
+        const size_t offset = size_t(aligned - base);
+        if (offset + bytes > m_block_size) return nullptr;
+        m_offset = offset + bytes;
+        return m_block.get() + offset;
+    }
+
+    // Keeps the current block alive until the reset and continues in a new one that is at least twice as large
+    void add_block(size_t min_size) {
+        if (m_block) {
+            m_retired.push_back({ std::move(m_block), m_block_size, m_offset });
+        }
+        const size_t size = std::max(std::max(size_t(MIN_BLOCK_SIZE), min_size), m_block_size * 2); // a copy, std::max would ODR-use MIN_BLOCK_SIZE
+        m_block.reset(new char[size]);
+        m_block_size = size;
+        m_offset = 0;
+    }
+};
+
+// std allocator on the calling thread's FrameArena. Deallocation is a no-op, the memory comes back with the reset.
+// Stateless, so a container may be grown by another thread than the one that created it, as in parallel_for chunks.
+template <typename T>
+struct FrameAllocator {
+    using value_type = T;
+
+    FrameAllocator() noexcept {
+    }
+
+    template <typename U>
+    FrameAllocator(const FrameAllocator<U>&) noexcept {
+    }
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(FrameArena::local().allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, size_t) noexcept {
+    }
+};
+
+template <typename T, typename U>
+inline bool operator==(const FrameAllocator<T>&, const FrameAllocator<U>&) {
+    return true;
+}
+
+template <typename T, typename U>
+inline bool operator!=(const FrameAllocator<T>&, const FrameAllocator<U>&) {
+    return false;
+}
+
+// A vector for scratch data of the current frame, see FrameArena
+template <typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
@@ -0,0 +1,295 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A pool of worker threads that run small jobs. Every thread has its own queue: a thread pushes and pops jobs at
+// the back of its own queue and, once that is empty, steals the oldest job from the front of another queue, so
+// jobs spawned by a job mostly stay on the thread that spawned them. Threads outside the pool (the main thread)
+// share queue 0. A thread that waits for jobs runs queued jobs until they are done instead of blocking, so jobs
+// may wait for other jobs, and parallel loops may be nested.
+//
+// The Application owns the job system for the game, systems reach it through JobSystem::get() or simply call
+// JobSystem::parallel_for_each_chunk, which runs inline when there is no job system.
+class JobSystem {
+public:
+    using Job = std::function<void()>;
+
+    // Counts the unfinished jobs of a group. Pass it to run() for each job of the group, then wait() on it.
+    // Jobs started with run_after() begin once the counter they depend on reaches zero.
+    class Counter {
+    public:
+        Counter() {
+        }
+
+        Counter(const Counter&) = delete;
+        Counter& operator=(const Counter&) = delete;
+
+        bool done() const {
+            return pending.load() == 0;
+        }
+
+    private:
+        friend class JobSystem;
+
+        struct Continuation {
+            Job job;
+            Counter* counter;
+        };
+
+        std::atomic<int> pending{ 0 };
+        std::mutex mutex;
+        std::vector<Continuation> continuations;
+        std::exception_ptr error; // the first exception thrown by a job of the group, rethrown by wait()
+    };
+
+    // The main thread takes part in the work as well, so the default leaves one hardware thread to it
+    static unsigned int default_worker_count() {
+        const unsigned int hardware = std::thread::hardware_concurrency();
+        return hardware > 1 ? hardware - 1 : 0;
+    }
+
+    explicit JobSystem(unsigned int worker_count = default_worker_count()) {
+        for (unsigned int i = 0; i <= worker_count; i++) {
+            queues.push_back(std::unique_ptr<Queue>(new Queue()));
+        }
+        for (unsigned int i = 1; i <= worker_count; i++) {
+            workers.emplace_back([this, i]() { worker_loop(i); });
+        }
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Queued jobs that have not started are dropped, wait for them first
+    ~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) worker.join();
+        if (get() == this) set_instance(nullptr);
+    }
+
+    // The job system of the running Application, or nullptr
+    static JobSystem* get() {
+        return instance();
+    }
+
+    static void set_instance(JobSystem* job_system) {
+        instance() = job_system;
+    }
+
+    // Workers plus the thread that waits
+    unsigned int thread_count() const {
+        return (unsigned int)queues.size();
+    }
+
+    // Queues a job. If counter is given it counts the job until the job has run.
+    void run(Job job, Counter* counter = nullptr) {
+        if (counter) counter->pending++;
+        push(std::move(job), counter);
+    }
+
+    // Queues a job once every job counted by dependency has finished
+    void run_after(Counter& dependency, Job job, Counter* counter = nullptr) {
+        if (counter) counter->pending++;
+        {
+            std::lock_guard<std::mutex> lock(dependency.mutex);
+            if (dependency.pending.load() > 0) {
+                dependency.continuations.push_back({ std::move(job), counter });
+                return;
+            }
+        }
+        push(std::move(job), counter);
+    }
+
+    // Runs queued jobs until every job of the counter has finished, then rethrows the first exception of the group
+    void wait(Counter& counter) {
+        const unsigned int queue = current_queue();
+        while (counter.pending.load() > 0) {
+            if (!run_one(queue)) std::this_thread::yield();
+        }
+        std::exception_ptr error;
+        {
+            std::lock_guard<std::mutex> lock(counter.mutex);
+            std::swap(error, counter.error);
+        }
+        if (error) std::rethrow_exception(error);
+    }
+
+    // Calls func(chunk_begin, chunk_end) on chunks of [begin, end) in parallel and returns when all are done.
+    // Chunks hold at least min_chunk items, and the calling thread runs the first one itself.
+    template <typename Func>
+    void parallel_for(size_t begin, size_t end, size_t min_chunk, Func func) {
+        if (end <= begin) return;
+        const size_t count = end - begin;
+        // A few chunks per thread even out chunks that take longer than others
+        const size_t chunk = std::max<size_t>(std::max<size_t>(min_chunk, 1), (count + thread_count() * 4 - 1) / (thread_count() * 4));
+        if (count <= chunk || thread_count() == 1) {
+            func(begin, end);
+            return;
+        }
+
+        // Jobs capture the shared range by reference and their own start, which fits in std::function's small buffer,
+        // so queueing a chunk does not allocate
+        struct Range {
+            Func& func;
+            size_t end;
+            size_t chunk;
+        } range{ func, end, chunk };
+        Counter counter;
+        for (size_t chunk_begin = begin + chunk; chunk_begin < end; chunk_begin += chunk) {
+            run([&range, chunk_begin]() { range.func(chunk_begin, std::min(range.end, chunk_begin + range.chunk)); }, &counter);
+        }
+        try {
+            func(begin, begin + chunk);
+        } catch (...) {
+            wait(counter); // the other chunks still reference func
+            throw;
+        }
+        wait(counter);
+    }
+
+    // parallel_for on the Application's job system, or a plain loop over one chunk when there is none
+    template <typename Func>
+    static void parallel_for_each_chunk(size_t begin, size_t end, size_t min_chunk, Func func) {
+        if (JobSystem* job_system = get()) {
+            job_system->parallel_for(begin, end, min_chunk, func);
+        } else if (begin < end) {
+            func(begin, end);
+        }
+    }
+
+private:
+    struct Task {
+        Job job;
+        Counter* counter;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues; // queue 0 belongs to the threads outside the pool
+    std::vector<std::thread> workers;
+
+    std::atomic<size_t> queued{ 0 };
+    std::atomic<unsigned int> sleeping{ 0 };
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    static JobSystem*& instance() {
+        static JobSystem* job_system = nullptr;
+        return job_system;
+    }
+
+    // The pool and queue of the calling thread, set once by each worker
+    struct ThreadSlot {
+        const JobSystem* owner = nullptr;
+        unsigned int queue = 0;
+    };
+
+    static ThreadSlot& thread_slot() {
+        static thread_local ThreadSlot slot;
+        return slot;
+    }
+
+    unsigned int current_queue() const {
+        const ThreadSlot& slot = thread_slot();
+        return slot.owner == this ? slot.queue : 0;
+    }
+
+    void push(Job job, Counter* counter) {
+        // queued is raised before sleeping is read and a worker does the opposite, so one of them sees the other.
+        // Raising it before the push only means a thief may look for the job a moment too early.
+        queued++;
+        Queue& queue = *queues[current_queue()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back({ std::move(job), counter });
+        }
+        if (sleeping.load() > 0) {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            wake.notify_one();
+        }
+    }
+
+    // Newest job of the own queue first, then the oldest job of the others
+    bool pop(unsigned int own, Task& task) {
+        if (queued.load() == 0) return false;
+        for (size_t i = 0; i < queues.size(); i++) {
+            Queue& queue = *queues[(own + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty()) continue;
+            if (i == 0) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            } else {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+            queued--;
+            return true;
+        }
+        return false;
+    }
+
+    bool run_one(unsigned int queue) {
+        Task task;
+        if (!pop(queue, task)) return false;
+        execute(task);
+        return true;
+    }
+
+    void execute(Task& task) {
+        try {
+            task.job();
+        } catch (...) {
+            if (!task.counter) throw;
+            std::lock_guard<std::mutex> lock(task.counter->mutex);
+            if (!task.counter->error) task.counter->error = std::current_exception();
+        }
+        if (task.counter) finish(*task.counter);
+    }
+
+    // Releases the jobs that waited for the counter once its last job is done
+    // The counter is only touched under its mutex, which wait() takes as well, so a waiter that sees zero cannot
+    // destroy the counter while this is still using it.
+    void finish(Counter& counter) {
+        std::vector<Counter::Continuation> ready;
+        {
+            std::lock_guard<std::mutex> lock(counter.mutex);
+            if (--counter.pending > 0) return;
+            std::swap(ready, counter.continuations);
+        }
+        for (Counter::Continuation& continuation : ready) {
+            push(std::move(continuation.job), continuation.counter);
+        }
+    }
+
+    void worker_loop(unsigned int queue) {
+        thread_slot().owner = this;
+        thread_slot().queue = queue;
+        while (true) {
+            if (run_one(queue)) continue;
+
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            sleeping++;
+            wake.wait(lock, [&]() { return stopping || queued.load() > 0; });
+            sleeping--;
+            if (stopping) return;
+        }
+    }
+};
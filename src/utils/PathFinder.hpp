@@ -36,7 +36,7 @@ glm::vec2 get_next_point_of_path_to_player(
     int max_self_radius = int(std::ceil(self_radius)) + 1;
     int minimum_distance_found = -1;
     glm::vec2 next_position = {start_i, start_j};
-    std::vector<glm::vec2> directions = {
+    const glm::vec2 directions[] = {
         {1, 0}, {-1, 0}, {0, 1}, {0, -1},
         {1, 1}, {1, -1}, {-1, 1}, {-1, -1}
     };
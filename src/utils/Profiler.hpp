@@ -0,0 +1,236 @@
+#pragma once
+
+// Scoped-zone frame profiler. Put PROFILE_ZONE("name") at the top of a scope to time it. Every thread records its
+// zones into its own ring buffer without locking, Profiler::end_frame() folds the zones of the last frame into
+// rolling per-zone statistics for the in-game table (F3), and Profiler::write_chrome_trace() dumps the zones still
+// in the ring buffers as Chrome trace_event JSON (F4), which chrome://tracing and ui.perfetto.dev open.
+//
+// Build with PROFILER_ENABLED=0 to compile it out: the zones expand to nothing and the functions do nothing.
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+#include <string>
+#include <vector>
+
+#if PROFILER_ENABLED
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#endif
+
+namespace Profiler {
+    // One row of the in-game table, times in milliseconds over the last WINDOW_FRAMES frames
+    struct ZoneSummary {
+        std::string name;
+        float min_ms;
+        float avg_ms;
+        float p99_ms;
+    };
+
+#if PROFILER_ENABLED
+    // Frames kept for the rolling statistics
+    constexpr size_t WINDOW_FRAMES = 240;
+
+    struct ZoneEvent {
+        const char* name;
+        long long start_ns;
+        long long end_ns;
+    };
+
+    // Written only by its own thread. written counts every event ever recorded, event i is in slot i % CAPACITY.
+    struct ThreadBuffer {
+        static constexpr size_t CAPACITY = 1 << 14;
+        std::vector<ZoneEvent> events = std::vector<ZoneEvent>(CAPACITY);
+        std::atomic<unsigned long long> written{ 0 };
+        unsigned long long frame_read = 0; // events already folded into the statistics, only used by end_frame
+        unsigned int thread_index = 0;
+    };
+
+    struct ZoneStats {
+        std::vector<float> frame_ms; // ring of the per-frame totals
+        size_t next = 0;
+        float current_ms = 0; // total of the frame being collected
+    };
+
+    struct State {
+        std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+        std::mutex mutex; // guards buffers and names, never taken while recording a zone
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+        std::unordered_set<std::string> names;
+        std::unordered_map<std::string, ZoneStats> stats; // by name, the same literal may have several addresses. Only touched by end_frame.
+    };
+
+    inline State& _state() {
+        static State state;
+        return state;
+    }
+
+    inline long long _now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _state().epoch).count();
+    }
+
+    // The buffer of the calling thread, registered on its first zone
+    inline ThreadBuffer& _thread_buffer() {
+        static thread_local ThreadBuffer* buffer = nullptr;
+        if (!buffer) {
+            State& state = _state();
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.buffers.push_back(std::make_shared<ThreadBuffer>());
+            buffer = state.buffers.back().get();
+            buffer->thread_index = (unsigned int)state.buffers.size() - 1;
+        }
+        return *buffer;
+    }
+
+    inline void _record(const char* name, long long start_ns, long long end_ns) {
+        ThreadBuffer& buffer = _thread_buffer();
+        const unsigned long long index = buffer.written.load(std::memory_order_relaxed);
+        buffer.events[index % ThreadBuffer::CAPACITY] = { name, start_ns, end_ns };
+        buffer.written.store(index + 1, std::memory_order_release);
+    }
+
+    // Copies the events [from, written) of a buffer that are still in the ring. Events the owner may have overwritten
+    // while they were copied are dropped, so a reader never has to stop the owner.
+    inline unsigned long long _read_events(ThreadBuffer& buffer, unsigned long long from, std::vector<ZoneEvent>& out) {
+        const unsigned long long written = buffer.written.load(std::memory_order_acquire);
+        from = std::max(from, written > ThreadBuffer::CAPACITY ? written - ThreadBuffer::CAPACITY : 0ull);
+        const size_t first = out.size();
+        for (unsigned long long i = from; i < written; i++) {
+            out.push_back(buffer.events[i % ThreadBuffer::CAPACITY]);
+        }
+        const unsigned long long after = buffer.written.load(std::memory_order_acquire);
+        if (after > ThreadBuffer::CAPACITY && after - ThreadBuffer::CAPACITY > from) {
+            const size_t overwritten = (size_t)std::min(after - ThreadBuffer::CAPACITY - from, written - from);
+            out.erase(out.begin() + first, out.begin() + first + overwritten);
+        }
+        return written;
+    }
+
+    // Times the enclosing scope
+    class Zone {
+        const char* m_name;
+        long long m_start_ns;
+    public:
+        // name has to outlive the profiler, use a string literal or intern()
+        explicit Zone(const char* name) : m_name(name), m_start_ns(_now_ns()) {}
+        ~Zone() { _record(m_name, m_start_ns, _now_ns()); }
+
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+    };
+
+    // A copy of name that lives as long as the program, for zone names built at runtime
+    inline const char* intern(const std::string& name) {
+        State& state = _state();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        return state.names.insert(name).first->c_str();
+    }
+
+    // Call once per frame from the main thread, while no other thread records zones of the finished frame.
+    // Adds up the time of every zone in the frame, a zone that ran several times counts with its total.
+    inline void end_frame() {
+        State& state = _state();
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            buffers = state.buffers;
+        }
+
+        std::vector<ZoneEvent> events;
+        for (auto& buffer : buffers) {
+            buffer->frame_read = _read_events(*buffer, buffer->frame_read, events);
+        }
+        for (const ZoneEvent& event : events) {
+            state.stats[event.name].current_ms += (event.end_ns - event.start_ns) * 1e-6f;
+        }
+        // Zones that did not run this frame count as 0, so the table shows how they spread over the frames
+        for (auto& kv : state.stats) {
+            ZoneStats& stats = kv.second;
+            if (stats.frame_ms.size() < WINDOW_FRAMES) {
+                stats.frame_ms.push_back(stats.current_ms);
+            } else {
+                stats.frame_ms[stats.next] = stats.current_ms;
+            }
+            stats.next = (stats.next + 1) % WINDOW_FRAMES;
+            stats.current_ms = 0;
+        }
+    }
+
+    // The rolling statistics of every zone, slowest average first
+    inline std::vector<ZoneSummary> summaries() {
+        std::vector<ZoneSummary> result;
+        std::vector<float> sorted;
+        for (auto& kv : _state().stats) {
+            const std::vector<float>& frame_ms = kv.second.frame_ms;
+            if (frame_ms.empty()) continue;
+            sorted = frame_ms;
+            std::sort(sorted.begin(), sorted.end());
+            float sum = 0;
+            for (float ms : sorted) sum += ms;
+            const size_t p99 = std::min(sorted.size() - 1, (size_t)(sorted.size() * 0.99f));
+            result.push_back({ kv.first, sorted.front(), sum / sorted.size(), sorted[p99] });
+        }
+        std::sort(result.begin(), result.end(), [](const ZoneSummary& a, const ZoneSummary& b) { return a.avg_ms > b.avg_ms; });
+        return result;
+    }
+
+    inline void _write_json_string(std::ofstream& out, const char* text) {
+        out << '"';
+        for (const char* c = text; *c; c++) {
+            if (*c == '"' || *c == '\\') out << '\\';
+            out << *c;
+        }
+        out << '"';
+    }
+
+    // Writes every zone still in the ring buffers, the last few seconds of the game, as Chrome trace_event JSON.
+    // Returns false if the file could not be opened.
+    inline bool write_chrome_trace(const std::string& path) {
+        std::ofstream out(path);
+        if (!out) return false;
+
+        State& state = _state();
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            buffers = state.buffers;
+        }
+
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        std::vector<ZoneEvent> events;
+        for (auto& buffer : buffers) {
+            events.clear();
+            _read_events(*buffer, 0, events);
+            for (const ZoneEvent& event : events) {
+                out << (first ? "\n" : ",\n") << "{\"name\":";
+                _write_json_string(out, event.name);
+                // Complete events, timestamps in microseconds
+                out << ",\"cat\":\"zone\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread_index
+                    << ",\"ts\":" << event.start_ns / 1000.0 << ",\"dur\":" << (event.end_ns - event.start_ns) / 1000.0 << "}";
+                first = false;
+            }
+        }
+        out << "\n]}\n";
+        return (bool)out;
+    }
+
+#define PROFILER_CONCAT_INNER(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) Profiler::Zone PROFILER_CONCAT(profiler_zone_, __LINE__)(name)
+
+#else
+    inline const char* intern(const std::string&) { return ""; }
+    inline void end_frame() {}
+    inline std::vector<ZoneSummary> summaries() { return {}; }
+    inline bool write_chrome_trace(const std::string&) { return false; }
+
+#define PROFILE_ZONE(name) ((void)0)
+#endif
+}
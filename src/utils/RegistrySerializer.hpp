@@ -20,7 +20,7 @@ private:
     static Entity find_mapped_entity(const EntityMap& map, unsigned int old_id) {
         auto it = std::find_if(map.begin(), map.end(),
             [old_id](const auto& pair) { return pair.first == old_id; });
-        return it != map.end() ? it->second : Entity();
+        return it != map.end() ? it->second : Entity::null();
     }
 
     static bool is_valid_entity(const Entity& entity) {
@@ -106,6 +106,11 @@ private:
                 registry.projectiles.get(entity));
         }
 
+        if (registry.continuous_collisions.has(entity)) {
+            entity_data["continuous_collision"] = ComponentSerializer::serialize_continuous_collision(
+                registry.continuous_collisions.get(entity));
+        }
+
         if (registry.attack_cooldowns.has(entity)) {
             entity_data["attack_cooldown"] = ComponentSerializer::serialize_cooldown(
                 registry.attack_cooldowns.get(entity).timer);
@@ -197,33 +202,7 @@ public:
         };
         
         // Collect from all component containers
-        collect_entities(registry.motions);
-        collect_entities(registry.locomotion_stats);
-        collect_entities(registry.weapons);
-        collect_entities(registry.teams);
-        collect_entities(registry.attackers);
-        collect_entities(registry.collision_bounds);
-        collect_entities(registry.walls);
-        collect_entities(registry.enemies);
-        collect_entities(registry.static_objects);
-        collect_entities(registry.ais);
-        collect_entities(registry.move_withs);
-        collect_entities(registry.rotate_withs);
-        collect_entities(registry.buffs);
-        collect_entities(registry.projectiles);
-        collect_entities(registry.attack_cooldowns);
-        collect_entities(registry.stagger_cooldowns);
-        collect_entities(registry.death_cooldowns);
-        collect_entities(registry.energy_no_regen_cooldowns);
-        collect_entities(registry.in_dodges);
-        collect_entities(registry.near_players);
-        collect_entities(registry.near_cameras);
-        collect_entities(registry.vision_to_players);
-        collect_entities(registry.textures);
-        collect_entities(registry.projectile_models);
-        collect_entities(registry.estus);
-        collect_entities(registry.interactables);
-        collect_entities(registry.light_sources);
+        registry.for_each_container(collect_entities);
         
         // Store global registry state
         registry_data["counter"] = registry.counter;
@@ -344,6 +323,14 @@ public:
                 ComponentSerializer::deserialize_projectile(projectile, entity_data["projectile"]);
             }
 
+            if (entity_data.contains("continuous_collision")) {
+                auto& continuous = registry.continuous_collisions.emplace(new_entity);
+                ComponentSerializer::deserialize_continuous_collision(continuous, entity_data["continuous_collision"]);
+            } else if (entity_data.contains("projectile") && registry.motions.has(new_entity)) {
+                // Saves from before projectiles were swept
+                registry.continuous_collisions.emplace(new_entity).start = registry.motions.get(new_entity).position;
+            }
+
             if (entity_data.contains("attack_cooldown")) {
                 float timer;
                 ComponentSerializer::deserialize_cooldown(timer, entity_data["attack_cooldown"]);
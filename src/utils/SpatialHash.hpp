@@ -0,0 +1,239 @@
+#pragma once
+
+#include <ecs/Entity.hpp>
+
+#include <glm/vec2.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Uniform grid over the plane for broad phase queries, rebuilt from scratch every frame.
+// Cells live in one open addressing table (linear probing) keyed by cell coordinates, and the entities of all
+// cells in one contiguous array, sorted by cell with a counting sort, so a cell is just a range of that array.
+// clear(), insert() and build() are O(n) and reuse the memory of the previous frame; the table only grows.
+// Queries never insert and iterate without allocating, so several threads may query the same built hash.
+class SpatialHash {
+public:
+    explicit SpatialHash(float cell_size)
+        : m_cell_size(cell_size) {
+    }
+
+    float cell_size() const {
+        return m_cell_size;
+    }
+
+    // Starts a new rebuild, the previous contents stay queryable until build()
+    void clear() {
+        m_pending.clear();
+    }
+
+    void insert(Entity entity, const glm::vec2& position) {
+        m_pending.push_back({ entity, cell_of(position.x), cell_of(position.y), 0 });
+    }
+
+    // Sorts the inserted entities into their cells. Entities of a cell keep their insertion order.
+    void build() {
+        // Sized for the cells of the last build, the table is at most half full so probe runs stay short
+        size_t capacity = std::max(size_t(MIN_SLOTS), m_slots.size()); // a copy, std::max would ODR-use MIN_SLOTS
+        while (capacity < m_cell_count * 2) capacity *= 2;
+        reset_slots(capacity);
+
+        // Counting sort: cell sizes, then the start of every cell, then every entity into its cell's range
+        for (size_t i = 0; i < m_pending.size(); i++) {
+            Pending& item = m_pending[i];
+            if (m_cell_count * 2 >= m_slots.size()) {
+                // More cells than last time, start over with a larger table
+                reset_slots(m_slots.size() * 2);
+                i = size_t(-1);
+                continue;
+            }
+            item.slot = find_or_add(item.x, item.y);
+            m_slots[item.slot].count++;
+        }
+        uint32_t start = 0;
+        for (Slot& slot : m_slots) {
+            if (slot.count == 0) continue;
+            slot.start = start;
+            start += slot.count;
+            slot.count = 0;
+        }
+        m_entities.resize(m_pending.size(), Entity::null()); // Entity() would create an entity
+        for (const Pending& item : m_pending) {
+            Slot& slot = m_slots[item.slot];
+            m_entities[slot.start + slot.count++] = item.entity;
+        }
+    }
+
+    size_t size() const {
+        return m_entities.size();
+    }
+
+    // Number of occupied cells
+    size_t cell_count() const {
+        return m_cell_count;
+    }
+
+    // Entities in the squares of cells that cover the circle (position, radius), visited column by column.
+    // A forward range for range-based for loops, it holds no memory of its own.
+    class Query {
+    public:
+        class iterator {
+        public:
+            Entity operator*() const {
+                return *m_current;
+            }
+
+            iterator& operator++() {
+                if (++m_current == m_end) m_query->next_cell(*this);
+                return *this;
+            }
+
+            // Only the end iterator has no current entity
+            bool operator==(const iterator& other) const {
+                return m_current == other.m_current;
+            }
+
+            bool operator!=(const iterator& other) const {
+                return !(*this == other);
+            }
+
+        private:
+            friend class Query;
+            const Query* m_query = nullptr;
+            int m_x = 0;
+            int m_y = 0;
+            const Entity* m_current = nullptr;
+            const Entity* m_end = nullptr;
+        };
+
+        iterator begin() const {
+            iterator it;
+            it.m_query = this;
+            it.m_x = m_min_x;
+            it.m_y = m_min_y - 1;
+            next_cell(it);
+            return it;
+        }
+
+        iterator end() const {
+            iterator it;
+            it.m_query = this;
+            return it;
+        }
+
+    private:
+        friend class SpatialHash;
+        const SpatialHash* m_hash;
+        int m_min_x, m_max_x, m_min_y, m_max_y;
+
+        // Moves it to the first entity of the next occupied cell after its current one, or to end()
+        void next_cell(iterator& it) const {
+            while (true) {
+                if (++it.m_y > m_max_y) {
+                    it.m_y = m_min_y;
+                    if (++it.m_x > m_max_x) {
+                        it.m_current = it.m_end = nullptr;
+                        return;
+                    }
+                }
+                const Slot* slot = m_hash->find(it.m_x, it.m_y);
+                if (slot) {
+                    it.m_current = m_hash->m_entities.data() + slot->start;
+                    it.m_end = it.m_current + slot->count;
+                    return;
+                }
+            }
+        }
+    };
+
+    Query query(const glm::vec2& position, float radius) const {
+        Query result;
+        result.m_hash = this;
+        const int center_x = cell_of(position.x);
+        const int center_y = cell_of(position.y);
+        const int cell_radius = static_cast<int>(std::ceil(radius / m_cell_size));
+        result.m_min_x = center_x - cell_radius;
+        result.m_max_x = center_x + cell_radius;
+        result.m_min_y = center_y - cell_radius;
+        result.m_max_y = center_y + cell_radius;
+        return result;
+    }
+
+    // Calls func(entity) for every entity of query(position, radius)
+    template <typename Func>
+    void for_each(const glm::vec2& position, float radius, Func func) const {
+        for (Entity entity : query(position, radius)) func(entity);
+    }
+
+private:
+    static constexpr size_t MIN_SLOTS = 64;
+
+    struct Slot {
+        int x = 0;
+        int y = 0;
+        uint32_t start = 0;
+        uint32_t count = 0; // 0 marks a free slot
+    };
+
+    struct Pending {
+        Entity entity;
+        int x;
+        int y;
+        uint32_t slot;
+    };
+
+    float m_cell_size;
+    std::vector<Slot> m_slots; // power of two size
+    size_t m_mask = 0;
+    unsigned int m_shift = 64; // 64 - log2 of the table size
+    size_t m_cell_count = 0;
+    std::vector<Entity> m_entities; // grouped by cell
+    std::vector<Pending> m_pending;
+
+    void reset_slots(size_t capacity) {
+        if (capacity != m_slots.size()) {
+            m_slots.assign(capacity, Slot());
+        } else {
+            for (Slot& slot : m_slots) slot.count = 0;
+        }
+        m_mask = capacity - 1;
+        m_shift = 64;
+        for (size_t size = capacity; size > 1; size >>= 1) m_shift--;
+        m_cell_count = 0;
+    }
+
+    int cell_of(float coordinate) const {
+        return static_cast<int>(std::floor(coordinate / m_cell_size));
+    }
+
+    // Fibonacci hashing: the top bits of the key times 2^64 / golden ratio. The low bits of a plain multiply and xor
+    // of the coordinates repeat along rows and columns of cells, which piled up long probe runs.
+    size_t slot_of(int x, int y) const {
+        const uint64_t key = (uint64_t(uint32_t(x)) << 32) | uint32_t(y);
+        return size_t((key * 0x9E3779B97F4A7C15ull) >> m_shift);
+    }
+
+    const Slot* find(int x, int y) const {
+        if (m_slots.empty()) return nullptr;
+        for (size_t i = slot_of(x, y);; i = (i + 1) & m_mask) {
+            const Slot& slot = m_slots[i];
+            if (slot.count == 0) return nullptr;
+            if (slot.x == x && slot.y == y) return &slot;
+        }
+    }
+
+    uint32_t find_or_add(int x, int y) {
+        for (size_t i = slot_of(x, y);; i = (i + 1) & m_mask) {
+            Slot& slot = m_slots[i];
+            if (slot.count == 0) {
+                slot.x = x;
+                slot.y = y;
+                m_cell_count++;
+                return uint32_t(i);
+            }
+            if (slot.x == x && slot.y == y) return uint32_t(i);
+        }
+    }
+};
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <ecs/Entity.hpp>
+
+#include <glm/common.hpp>
+#include <glm/vec2.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Bounding volume hierarchy over axis aligned boxes that do not move, such as walls and static objects.
+// Built once from all boxes, by splitting the boxes of a node at the median of their centres along the longer
+// side, until a node holds at most LEAF_SIZE boxes. The nodes live in one array with the two children of a node
+// next to each other, and the boxes in another, ordered so the boxes of a leaf are one range.
+// Unlike a grid keyed by the centre, a box is found by every query it overlaps, however long it is.
+// Queries never allocate and only read, so several threads may query the same tree.
+class StaticBVH {
+public:
+    struct Item {
+        glm::vec2 min;
+        glm::vec2 max;
+        Entity entity;
+    };
+
+    // Replaces the contents with items, their order decides the order of query results
+    void build(std::vector<Item> items) {
+        m_items = std::move(items);
+        m_nodes.clear();
+        if (m_items.empty()) return;
+        m_nodes.reserve(2 * (m_items.size() / LEAF_SIZE + 1));
+        m_nodes.emplace_back();
+        build_node(0, 0, uint32_t(m_items.size()));
+    }
+
+    void clear() {
+        m_items.clear();
+        m_nodes.clear();
+    }
+
+    size_t size() const {
+        return m_items.size();
+    }
+
+    bool empty() const {
+        return m_items.empty();
+    }
+
+    // Calls func(entity) for every box that overlaps or touches the box (min, max)
+    template <typename Func>
+    void query(const glm::vec2& min, const glm::vec2& max, Func func) const {
+        if (m_nodes.empty()) return;
+        uint32_t stack[MAX_DEPTH];
+        size_t top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Node& node = m_nodes[stack[--top]];
+            if (!overlaps(node.min, node.max, min, max)) continue;
+            if (node.count > 0) {
+                for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                    const Item& item = m_items[i];
+                    if (overlaps(item.min, item.max, min, max)) func(item.entity);
+                }
+            } else {
+                // Right child first, so the left one is visited first
+                stack[top++] = node.first + 1;
+                stack[top++] = node.first;
+            }
+        }
+    }
+
+private:
+    static constexpr uint32_t LEAF_SIZE = 4;
+    // Median splits halve the boxes, so the depth stays below log2 of their count
+    static constexpr size_t MAX_DEPTH = 64;
+
+    struct Node {
+        glm::vec2 min;
+        glm::vec2 max;
+        uint32_t first = 0; // the first item of a leaf, or the left child of the children at first and first + 1
+        uint32_t count = 0; // number of items of a leaf, 0 for inner nodes
+    };
+
+    std::vector<Node> m_nodes; // m_nodes[0] is the root
+    std::vector<Item> m_items;
+
+    static bool overlaps(const glm::vec2& min_a, const glm::vec2& max_a, const glm::vec2& min_b, const glm::vec2& max_b) {
+        return min_a.x <= max_b.x && min_b.x <= max_a.x && min_a.y <= max_b.y && min_b.y <= max_a.y;
+    }
+
+    // Takes an index since adding the children may move the nodes
+    void build_node(uint32_t index, uint32_t begin, uint32_t end) {
+        glm::vec2 min = m_items[begin].min;
+        glm::vec2 max = m_items[begin].max;
+        glm::vec2 centre_min = (min + max) * 0.5f;
+        glm::vec2 centre_max = centre_min;
+        for (uint32_t i = begin + 1; i < end; i++) {
+            const Item& item = m_items[i];
+            min = glm::min(min, item.min);
+            max = glm::max(max, item.max);
+            const glm::vec2 centre = (item.min + item.max) * 0.5f;
+            centre_min = glm::min(centre_min, centre);
+            centre_max = glm::max(centre_max, centre);
+        }
+        m_nodes[index].min = min;
+        m_nodes[index].max = max;
+
+        if (end - begin <= LEAF_SIZE) {
+            m_nodes[index].first = begin;
+            m_nodes[index].count = end - begin;
+            return;
+        }
+
+        // Centres are compared doubled, which orders them the same as halved
+        const int axis = (centre_max.x - centre_min.x >= centre_max.y - centre_min.y) ? 0 : 1;
+        const uint32_t mid = begin + (end - begin) / 2;
+        std::nth_element(m_items.begin() + begin, m_items.begin() + mid, m_items.begin() + end,
+            [axis](const Item& a, const Item& b) {
+                return a.min[axis] + a.max[axis] < b.min[axis] + b.max[axis];
+            });
+
+        const uint32_t left = uint32_t(m_nodes.size());
+        m_nodes[index].first = left;
+        m_nodes[index].count = 0;
+        m_nodes.emplace_back();
+        m_nodes.emplace_back();
+        build_node(left, begin, mid);
+        build_node(left + 1, mid, end);
+    }
+};